@@ -10,52 +10,310 @@
 #ifndef BTREE_H
 #define BTREE_H
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <cstddef>
+#include <functional>
 #include <utility>
 #include <vector>
 #include <memory>
+#include <new>
 #include <iterator>
+#include <numeric>
 #include <queue>
+#include <thread>
+#include <type_traits>
 // we better include the iterator
 #include "btree_iterator.h"
+#include "btree_parallel.h"
+#include "btree_search.h"
 
 // we do this to avoid compiler errors about non-template friends
 // what do we do, remember? :)
 
-template <typename T>
+template <typename K, typename V, size_t N, bool Linked, typename Compare>
+class btree_map;
+
+/**
+ * btree<T> sizes its nodes at run time, given to the constructor.
+ * btree<T, N> fixes the capacity at N elements per node at compile time,
+ * keeping the values and subtrees in arrays inside the node itself.
+ *
+ * btree<T, N, true>, or linked_btree<T, N>, is a B+tree: every element
+ * lives in a leaf, internal nodes only hold copies of elements that
+ * separate their subtrees, and each leaf points to its neighbours.
+ * Iterating is then a walk along the leaves that never goes back up.
+ *
+ * Elements are ordered by Compare, std::less<T> unless given, and two are
+ * the same element when neither is less than the other. A transparent
+ * Compare, such as std::less<>, lets lookups take any key it can order
+ * against T without building a T from it.
+ *
+ * A Mapped type other than void gives every element a mapped value, kept in
+ * an array of its own beside the node's keys; see btree_map, which is built
+ * on it.
+ */
+template <typename T, size_t N = 0, bool Linked = false, typename Compare = std::less<T>, typename Mapped = void>
 class btree {
+    static_assert(N != 1, "a node must be able to hold at least 2 elements to be split");
+public:
+    static constexpr bool linked = Linked;
+    static constexpr bool is_map = !std::is_void<Mapped>::value;
+    using key_compare = Compare;
 private:
-    class bnode {
+    // Whether snapshot() can share nodes with this tree, see own()
+    static constexpr bool shareable = !Linked && !is_map && std::is_copy_constructible<T>::value;
+    // Whether a K can be looked up directly: it is a T, or Compare is transparent
+    template <typename K, typename C = Compare, typename = void>
+    struct lookup_key : std::is_same<K, T> {};
+    template <typename K, typename C>
+    struct lookup_key<K, C, typename std::conditional<true, void, typename C::is_transparent>::type>
+        : std::true_type {};
+    class node_arena;
+    class bnode;
+    /**
+     * Lets a node's vectors take their buffers from the tree's arena.
+     */
+    template <typename U>
+    class arena_allocator {
+    public:
+        using value_type = U;
+
+        arena_allocator(node_arena *arena) : _arena(arena) {};
+        template <typename V>
+        arena_allocator(const arena_allocator<V> &other) : _arena(other._arena) {};
+
+        U* allocate(size_t n) {
+            return static_cast<U*>(_arena->allocate(n * sizeof(U)));
+        }
+        void deallocate(U* p, size_t n) {
+            _arena->deallocate(p, n * sizeof(U));
+        }
+        template <typename V>
+        bool operator==(const arena_allocator<V> &other) const {
+            return _arena == other._arena;
+        }
+        template <typename V>
+        bool operator!=(const arena_allocator<V> &other) const {
+            return _arena != other._arena;
+        }
+
+        node_arena *_arena;
+    };
+    /**
+     * The parts of the std::vector interface the nodes use, over a std::array.
+     * Holds the values and subtrees of fixed capacity nodes, so each node is
+     * a single block. Slots past the end are kept value-initialised.
+     */
+    template <typename U, size_t Capacity>
+    class inline_vector {
+    public:
+        using value_type = U;
+        using iterator = U*;
+        using const_iterator = const U*;
+
+        // Takes the arena like the allocator-aware vectors, but stores inline
+        explicit inline_vector(node_arena*) : _data(), _count(0) {};
+        inline_vector& operator=(const inline_vector& other) {
+            resize(0);
+            std::copy(other.begin(), other.end(), begin());
+            _count = other._count;
+            return *this;
+        }
+
+        iterator begin() { return _data.data(); }
+        iterator end() { return _data.data() + _count; }
+        const_iterator begin() const { return _data.data(); }
+        const_iterator end() const { return _data.data() + _count; }
+        U* data() { return _data.data(); }
+        const U* data() const { return _data.data(); }
+        size_t size() const { return _count; }
+        bool empty() const { return _count == 0; }
+        U& operator[](size_t i) { return _data[i]; }
+        const U& operator[](size_t i) const { return _data[i]; }
+        U& front() { return _data[0]; }
+        U& back() { return _data[_count - 1]; }
+        const U& front() const { return _data[0]; }
+        const U& back() const { return _data[_count - 1]; }
+
+        void reserve(size_t) {}
+        void resize(size_t count) {
+            for (auto i = count; i < _count; ++i)
+                _data[i] = U();
+            _count = count;
+        }
+        void push_back(const U& val) {
+            _data[_count++] = val;
+        }
+        void push_back(U&& val) {
+            _data[_count++] = std::move(val);
+        }
+        void emplace_back() {
+            _data[_count++] = U();
+        }
+        void pop_back() {
+            _data[--_count] = U();
+        }
+        iterator insert(const_iterator pos, const U& val) {
+            auto tmp = val;
+            auto it = begin() + (pos - begin());
+            std::move_backward(it, end(), end() + 1);
+            *it = std::move(tmp);
+            ++_count;
+            return it;
+        }
+        iterator insert(const_iterator pos, U&& val) {
+            auto it = begin() + (pos - begin());
+            std::move_backward(it, end(), end() + 1);
+            *it = std::move(val);
+            ++_count;
+            return it;
+        }
+        iterator erase(const_iterator pos) {
+            return erase(pos, pos + 1);
+        }
+        iterator erase(const_iterator first, const_iterator last) {
+            auto it = begin() + (first - begin());
+            auto new_end = std::move(it + (last - first), end(), it);
+            resize(new_end - begin());
+            return it;
+        }
+    private:
+        std::array<U, Capacity> _data;
+        size_t _count;
+    };
+    /**
+     * Stands in for the mapped values of a set, which has none. Has the
+     * parts of the vector interface the nodes use, each doing nothing.
+     */
+    struct empty_slot {};
+    class no_mapped : public empty_slot {
+    public:
+        using value_type = empty_slot;
+        using iterator = empty_slot*;
+
+        explicit no_mapped(node_arena*) {};
+
+        iterator begin() { return nullptr; }
+        iterator end() { return nullptr; }
+        empty_slot& operator[](size_t) { return *this; }
+        empty_slot& front() { return *this; }
+        empty_slot& back() { return *this; }
+
+        void reserve(size_t) {}
+        template <typename U>
+        void push_back(U&&) {}
+        void pop_back() {}
+        template <typename U>
+        iterator insert(iterator, U&&) { return nullptr; }
+        iterator erase(iterator) { return nullptr; }
+        iterator erase(iterator, iterator) { return nullptr; }
+    };
+    // A node can hold one value, and one subtree, more than its capacity
+    // while it is waiting to be split
+    using value_vector = typename std::conditional<N == 0,
+        std::vector<T, arena_allocator<T>>, inline_vector<T, N + 1>>::type;
+    using tree_vector = typename std::conditional<N == 0,
+        std::vector<bnode*, arena_allocator<bnode*>>, inline_vector<bnode*, N + 2>>::type;
+    using mapped_slot = typename std::conditional<is_map, Mapped, empty_slot>::type;
+    using mapped_vector = typename std::conditional<!is_map, no_mapped,
+        typename std::conditional<N == 0, std::vector<mapped_slot, arena_allocator<mapped_slot>>,
+                                  inline_vector<mapped_slot, N + 1>>::type>::type;
+    class inode;
+    /**
+     * The leaves of a leaf-linked tree point to their neighbours in order.
+     * Other trees leave the pointers out of their nodes.
+     */
+    class leaf_links {
+    public:
+        bnode* prev_leaf() const { return _prev; }
+        bnode* next_leaf() const { return _next; }
+        void set_prev(bnode* prev) { _prev = prev; }
+        void set_next(bnode* next) { _next = next; }
+    private:
+        bnode* _prev = nullptr;
+        bnode* _next = nullptr;
+    };
+    class no_leaf_links {
+    public:
+        bnode* prev_leaf() const { return nullptr; }
+        bnode* next_leaf() const { return nullptr; }
+        void set_prev(bnode*) {}
+        void set_next(bnode*) {}
+    };
+    /**
+     * A node on its own is a leaf, internal nodes are inodes (see below).
+     */
+    class bnode : public std::conditional<Linked, leaf_links, no_leaf_links>::type {
     public:
-        // There are n-1 sub-trees in between the n values.
-        // There are one sub-tree in each end
-        // Thus in total we have n + 1 sub trees
         unsigned int _size;
-        std::vector<T> _childVals;
-        std::vector<std::shared_ptr<bnode>> _childTrees;
-        std::weak_ptr<bnode> _parent;
+        bool _leaf;
+        // The parents, and roots, this node hangs off. More than one once
+        // a snapshot shares it, see own
+        unsigned int _refs;
+        // A map's mapped values, _mapped[i] belongs to _childVals[i]. Only
+        // its leaves have them if it is leaf-linked, see holds_mapped
+        mapped_vector _mapped;
+        value_vector _childVals;
+        bnode* _parent;
 
-        bnode(size_t maxNodeElems = 40, std::shared_ptr<bnode> parent = nullptr) : _size(maxNodeElems), _childTrees(_size + 1), _parent(parent) {
+        bnode(node_arena *arena, size_t maxNodeElems = 40, bnode* parent = nullptr, bool leaf = true) :
+        _size(maxNodeElems), _leaf(leaf), _refs(1), _mapped(arena), _childVals(arena), _parent(parent) {
             // reserve space instead of populating them for easy sorted insertion.
-            _childVals.reserve(_size);
+            // One extra slot holds the overflowing value until the node is split.
+            _childVals.reserve(_size + 1);
+            if (!Linked || leaf)
+                _mapped.reserve(_size + 1);
         };
 
         ~bnode() = default;
+        /**
+         * The subtree at idx, or nullptr if this is a leaf.
+         */
+        bnode* child(size_t idx) const {
+            return _leaf ? nullptr : children()[idx];
+        }
+        /**
+         * The number of elements in this node and every subtree below it.
+         */
+        size_t count() const {
+            return _leaf ? _childVals.size() : static_cast<const inode*>(this)->_count;
+        }
+        /**
+         * The subtrees of an internal node, must not be called on a leaf.
+         */
+        tree_vector& children() {
+            return static_cast<inode*>(this)->_childTrees;
+        }
+        const tree_vector& children() const {
+            return static_cast<const inode*>(this)->_childTrees;
+        }
+        /**
+         * Deep copies this node and every subtree below it, keeping the shape.
+         * The copy is owned by the given arena and hangs off the given parent.
+         */
+        bnode* clone(node_arena &arena, bnode* parent = nullptr) const {
+            auto res = _leaf ? arena.make(_size, parent) : arena.make_inode(_size, parent);
+            res->_childVals = _childVals;
+            res->_mapped = _mapped;
+            if (!_leaf)
+                static_cast<inode*>(res)->_count = count();
+            for (size_t i = 0; !_leaf && i <= _childVals.size(); ++i)
+                res->children()[i] = children()[i]->clone(arena, res);
+            return res;
+        }
         /**
          * Goes through the tree using level-order traversal a.k.a bfs
          * Returns a vector of the values
          */
         std::vector<T> bfs() const {
             // Copy all values
-            std::vector<T> res(_childVals);
-            std::queue<std::shared_ptr<bnode>> bfs_q;
+            std::vector<T> res(_childVals.begin(), _childVals.end());
+            std::queue<bnode*> bfs_q;
 
-            for (auto child : _childTrees) {
-                if(!child)
-                    continue;
-                bfs_q.push(child);
-            }
+            for (size_t i = 0; !_leaf && i <= _childVals.size(); ++i)
+                bfs_q.push(children()[i]);
             // for(auto child : _childTrees) {
             //     if(!child)
             //         continue;
@@ -66,44 +324,181 @@ private:
                 auto front = bfs_q.front();
                 bfs_q.pop();
                 std::copy(front->_childVals.begin(), front->_childVals.end(), std::back_inserter(res));
-                for (auto childTree : front->_childTrees) {
-                    if(!childTree)
-                        continue;
-                    bfs_q.push(childTree);
-                }
+                for (size_t i = 0; !front->_leaf && i <= front->_childVals.size(); ++i)
+                    bfs_q.push(front->children()[i]);
             }
             return res;
         }
     };
-    // Tree just has root
-    std::shared_ptr<bnode> _root;
-    using dt_tuple = std::pair<size_t, std::shared_ptr<bnode>>;
+    /**
+     * An internal node, a node together with its subtrees. Most nodes of
+     * a B-Tree are leaves, so leaving the subtree array out of them
+     * saves most of the space it would take.
+     */
+    class inode : public bnode {
+    public:
+        // There are n-1 sub-trees in between the n values.
+        // There are one sub-tree in each end
+        // Thus in total we have n + 1 sub trees
+        tree_vector _childTrees;
+        // Elements in this node and its subtrees, a leaf's is its size
+        size_t _count;
+
+        inode(node_arena *arena, size_t maxNodeElems = 40, bnode* parent = nullptr) :
+        bnode(arena, maxNodeElems, parent, false), _childTrees(arena), _count(0) {
+            // One extra slot holds the overflowing subtree until the node is split.
+            _childTrees.reserve(this->_size + 2);
+            _childTrees.resize(this->_size + 1);
+        };
+    };
+public:
+    /**
+     * Memory held by a tree's node arena, as reported by slab_usage().
+     */
+    struct slab_stats {
+        size_t slabs;           // slabs allocated so far
+        size_t slab_bytes;      // bytes reserved by those slabs
+        size_t used_bytes;      // bytes held by live nodes and their buffers
+        size_t free_bytes;      // bytes released and waiting to be reused
+    };
+private:
+    /**
+     * Owns the memory of every node of a tree, nodes only point at each other.
+     * Following a child or parent is then a plain load, with none of
+     * the reference counting shared_ptr does on every step.
+     *
+     * Nodes and their value and subtree buffers are carved out of large slabs.
+     * A released block goes on a free list for its size and is handed out
+     * again before anything new is carved. As every node of a tree has the
+     * same capacity there are only a few sizes, so a tree that keeps
+     * inserting and erasing soon stops allocating at all.
+     */
+    class node_arena {
+    public:
+        node_arena() : _next(nullptr), _slab_end(nullptr), _slab_bytes(0), _used_bytes(0), _free_bytes(0) {};
+        node_arena(const node_arena&) = delete;
+        node_arena& operator=(const node_arena&) = delete;
+
+        bnode* make(size_t maxNodeElems, bnode* parent = nullptr) {
+            return new (allocate(sizeof(bnode))) bnode(this, maxNodeElems, parent);
+        }
+        bnode* make_inode(size_t maxNodeElems, bnode* parent = nullptr) {
+            return new (allocate(sizeof(inode))) inode(this, maxNodeElems, parent);
+        }
+        void release(bnode* node) {
+            if (node->_leaf) {
+                node->~bnode();
+                deallocate(node, sizeof(bnode));
+            } else {
+                auto internal = static_cast<inode*>(node);
+                internal->~inode();
+                deallocate(internal, sizeof(inode));
+            }
+        }
+
+        void* allocate(size_t bytes) {
+            bytes = block_size(bytes);
+            _used_bytes += bytes;
+            auto &free_list = free_list_for(bytes);
+            if (free_list) {
+                auto block = free_list;
+                free_list = *static_cast<void**>(block);
+                _free_bytes -= bytes;
+                return block;
+            }
+            if (static_cast<size_t>(_slab_end - _next) < bytes) {
+                auto slab_bytes = bytes > kSlabBytes ? bytes : kSlabBytes;
+                _slabs.emplace_back(new char[slab_bytes]);
+                _slab_bytes += slab_bytes;
+                _next = _slabs.back().get();
+                _slab_end = _next + slab_bytes;
+            }
+            auto block = _next;
+            _next += bytes;
+            return block;
+        }
+        void deallocate(void* block, size_t bytes) {
+            bytes = block_size(bytes);
+            _used_bytes -= bytes;
+            _free_bytes += bytes;
+            auto &free_list = free_list_for(bytes);
+            *static_cast<void**>(block) = free_list;
+            free_list = block;
+        }
+
+        slab_stats stats() const {
+            return slab_stats{_slabs.size(), _slab_bytes, _used_bytes, _free_bytes};
+        }
+    private:
+        static constexpr size_t kSlabBytes = 64 * 1024;
+        static constexpr size_t kAlign = alignof(std::max_align_t);
+
+        static size_t block_size(size_t bytes) {
+            return std::max(bytes + kAlign - 1, sizeof(void*)) / kAlign * kAlign;
+        }
+        void*& free_list_for(size_t bytes) {
+            for (auto &free_list : _free_lists) {
+                if (free_list.first == bytes)
+                    return free_list.second;
+            }
+            _free_lists.emplace_back(bytes, nullptr);
+            return _free_lists.back().second;
+        }
+
+        std::vector<std::unique_ptr<char[]>> _slabs;
+        // Free blocks are chained through their first word
+        std::vector<std::pair<size_t, void*>> _free_lists;
+        char *_next;
+        char *_slab_end;
+        size_t _slab_bytes;
+        size_t _used_bytes;
+        size_t _free_bytes;
+    };
+    // Tree just has root, every node lives in the arena.
+    // The arena is held by pointer as nodes refer back to it, and shared
+    // with the snapshots of the tree, whose nodes live there too.
+    std::shared_ptr<node_arena> _nodes;
+    bnode* _root;
+    // The leftmost and rightmost leaves, where begin() and end() point
+    bnode* _first;
+    bnode* _last;
+    Compare _comp;
+    using dt_tuple = std::pair<size_t, bnode*>;
 
 public:
     /** Hmm, need some iterator typedefs here... friends? **/
-    using iterator = btree_iterator<T>;
-    using const_iterator = btree_iterator<T, std::add_const>;
+    using key_type = T;
+    using mapped_type = Mapped;
+    using value_type = typename std::conditional<is_map, std::pair<const T, mapped_slot>, T>::type;
+    using iterator = btree_iterator<btree<T, N, Linked, Compare, Mapped>>;
+    using const_iterator = btree_iterator<btree<T, N, Linked, Compare, Mapped>, std::add_const>;
     using reverse_iterator = std::reverse_iterator<iterator>;
     using const_reverse_iterator = std::reverse_iterator<const_iterator>;
     friend iterator;
     friend const_iterator;
     friend reverse_iterator;
     friend const_reverse_iterator;
+    template <typename, typename, size_t, bool, typename> friend class btree_map;
 
     /**
      * Constructs an empty btree.    Note that
      * the elements stored in your btree must
      * have a well-defined zero-arg constructor,
      * copy constructor, operator=, and destructor.
-     * The elements must also know how to order themselves
-     * relative to each other by implementing operator<
-     * and operator==. (These are already implemented on
+     * The elements must also be ordered by comp, by default
+     * through their operator<. (This is already implemented on
      * behalf of all built-ins: ints, doubles, strings, etc.)
      *
      * @param maxNodeElems the maximum number of elements
-     *                that can be stored in each B-Tree node
+     *                that can be stored in each B-Tree node,
+     *                a node must be able to hold at least 2 to be split.
+     *                Ignored by btree<T, N, Linked, Compare, Mapped>, whose nodes hold N.
+     * @param comp the ordering of the elements.
      */
-    btree(size_t maxNodeElems = 40) : _root(std::make_shared<bnode>(maxNodeElems)) {};
+    btree(size_t maxNodeElems = N ? N : 40, const Compare& comp = Compare())
+        : _nodes(std::make_shared<node_arena>()),
+          _root(_nodes->make(N ? N : std::max<size_t>(maxNodeElems, 2))),
+          _first(_root), _last(_root), _comp(comp) {};
 
     /**
      * The copy constructor and    assignment operator.
@@ -116,16 +511,18 @@ public:
 
     /**
      * Copy constructor
-     * Creates a new B-Tree as a copy of original.
+     * Creates a new B-Tree as a copy of original, cloned node by node
+     * so it has the same shape, in time linear in its size.
      *
      * @param original a const lvalue reference to a B-Tree object
      */
-    btree(const btree<T>& original) : btree(original._root->_size) {
-        // Get a list of all elements in original tree
-        // Insert them one by one
-        auto all_values = original._root->bfs();
-        for (auto i : all_values) {
-            this->insert(i);
+    btree(const btree<T, N, Linked, Compare, Mapped>& original)
+        : _nodes(std::make_shared<node_arena>()),
+          _root(original._root->clone(*_nodes)), _comp(original._comp) {
+        find_ends();
+        if (linked) {
+            bnode* prev = nullptr;
+            link_leaves(_root, prev);
         }
     };
 
@@ -135,7 +532,11 @@ public:
      *
      * @param original an rvalue reference to a B-Tree object
      */
-    btree(btree<T>&& original) : _root(std::move(original._root)){};
+    btree(btree<T, N, Linked, Compare, Mapped>&& original)
+        : _nodes(std::move(original._nodes)), _root(original._root),
+          _first(original._first), _last(original._last), _comp(original._comp) {
+        original._root = original._first = original._last = nullptr;
+    };
 
     /**
      * Copy assignment
@@ -143,7 +544,7 @@ public:
      *
      * @param rhs a const lvalue reference to a B-Tree object
      */
-    btree<T>& operator=(const btree<T>& rhs) {
+    btree<T, N, Linked, Compare, Mapped>& operator=(const btree<T, N, Linked, Compare, Mapped>& rhs) {
         auto rhs_copy(rhs);
         *this = std::move(rhs_copy);
         return *this;
@@ -156,12 +557,181 @@ public:
      *
      * @param rhs a const reference to a B-Tree object
      */
-    btree<T>& operator=(btree<T>&& rhs) {
+    btree<T, N, Linked, Compare, Mapped>& operator=(btree<T, N, Linked, Compare, Mapped>&& rhs) {
         auto rhs_new(std::move(rhs));
-        this->_root = std::move(rhs_new._root);
+        std::swap(_nodes, rhs_new._nodes);
+        std::swap(_root, rhs_new._root);
+        std::swap(_first, rhs_new._first);
+        std::swap(_last, rhs_new._last);
+        std::swap(_comp, rhs_new._comp);
         return *this;
     };
 
+    /**
+     * Bulk load constructor
+     * Creates a B-Tree holding the elements in [first, last), see assign.
+     *
+     * @param first, last the range of elements to load
+     * @param maxNodeElems the maximum number of elements
+     *                that can be stored in each B-Tree node
+     * @param fill the fraction of each node to fill, see assign
+     * @param comp the ordering of the elements.
+     */
+    template <typename InputIt>
+    btree(InputIt first, InputIt last, size_t maxNodeElems = N ? N : 40, double fill = 1.0,
+          const Compare& comp = Compare()) : btree(maxNodeElems, comp) {
+        assign(first, last, fill);
+    };
+
+    /**
+     * Replaces the contents of this object with the elements in [first, last).
+     * While the range is sorted the tree is built bottom-up in linear time:
+     * leaves are packed left to right and each level of interior nodes is
+     * built from the separators of the level below. Duplicates are skipped.
+     * Should an element be out of order, the rest of the range is inserted
+     * one at a time instead.
+     *
+     * @param first, last the range of elements to load
+     * @param fill the fraction of each node to fill, between half full and full.
+     *                Leaving room makes later inserts less likely to split.
+     */
+    template <typename InputIt>
+    void assign(InputIt first, InputIt last, double fill = 1.0) {
+        static_assert(!is_map, "bulk loading only builds sets");
+        size_t cap = _root->_size;
+        destroy(_root);
+        auto target = fill_target(cap, fill);
+
+        // Pack the leaf level, every target + 1st element separates two leaves
+        std::vector<bnode*> nodes{_nodes->make(cap)};
+        std::vector<T> seps;
+        const T *prev = nullptr;
+        for (; first != last; ++first) {
+            const auto &elem = *first;
+            if (prev && !_comp(*prev, elem)) {
+                if (!_comp(elem, *prev))
+                    continue;
+                break;
+            }
+            auto &leaf = nodes.back()->_childVals;
+            if (leaf.size() < target) {
+                leaf.push_back(elem);
+                prev = &leaf.back();
+            } else if (!linked) {
+                seps.push_back(elem);
+                prev = &seps.back();
+                nodes.push_back(_nodes->make(cap));
+            } else {
+                // The separator is a copy, the element starts the next leaf
+                seps.push_back(elem);
+                nodes.push_back(_nodes->make(cap));
+                link(nodes[nodes.size() - 2], nodes.back());
+                nodes.back()->_childVals.push_back(elem);
+                prev = &nodes.back()->_childVals.back();
+            }
+        }
+        build_levels(nodes, seps, cap, target);
+        for (; first != last; ++first)
+            insert(*first);
+    }
+
+    /**
+     * assign for a range that is already sorted, building the leaf level on
+     * several threads. One pass over the range, split between them, checks
+     * its order and counts the distinct elements in each slice; from those
+     * counts every element knows the leaf and slot it goes to, so a second
+     * pass copies the slices into the leaves at once. The few levels above
+     * are built as assign builds them.
+     *
+     * A range that turns out not to be sorted is loaded by assign instead.
+     *
+     * @param first, last the range of elements to load
+     * @param threads the number of threads to build with, including this one.
+     * @param fill as for assign.
+     */
+    template <typename RandomIt>
+    void parallel_assign(RandomIt first, RandomIt last, unsigned threads = std::thread::hardware_concurrency(),
+                         double fill = 1.0) {
+        static_assert(!is_map, "bulk loading only builds sets");
+        // Slices below this are not worth a thread
+        constexpr size_t kMinSlice = 4096;
+        size_t n = last - first;
+        size_t tasks = std::min<size_t>(threads, n / kMinSlice);
+        if (tasks <= 1) {
+            assign(first, last, fill);
+            return;
+        }
+        auto slice = [n, tasks] (size_t t) { return n * t / tasks; };
+        // An element is skipped as a duplicate if it is not after the one before
+        auto is_new = [this, first] (size_t i) { return i == 0 || _comp(first[i - 1], first[i]); };
+        std::vector<size_t> starts(tasks + 1, 0);
+        std::vector<char> sorted(tasks, 1);
+        btree_parallel_for(tasks, [&] (size_t t) {
+            size_t count = 0;
+            for (auto i = slice(t); i < slice(t + 1); ++i) {
+                if (is_new(i))
+                    ++count;
+                else if (_comp(first[i], first[i - 1]))
+                    sorted[t] = 0;
+            }
+            starts[t + 1] = count;
+        });
+        if (std::find(sorted.begin(), sorted.end(), 0) != sorted.end()) {
+            assign(first, last, fill);
+            return;
+        }
+        std::partial_sum(starts.begin(), starts.end(), starts.begin());
+        size_t total = starts.back();
+
+        size_t cap = _root->_size;
+        destroy(_root);
+        auto target = fill_target(cap, fill);
+        // The k-th distinct element goes to leaf k / group, in the slot k % group.
+        // In a classic tree the last slot of a group is the separator after the leaf.
+        size_t group = linked ? target : target + 1;
+        size_t leaves = linked ? std::max<size_t>((total + target - 1) / target, 1) : total / group + 1;
+        std::vector<bnode*> nodes(leaves);
+        for (size_t j = 0; j < leaves; ++j) {
+            nodes[j] = _nodes->make(cap);
+            if (linked && j > 0)
+                link(nodes[j - 1], nodes[j]);
+        }
+        std::vector<T> seps(leaves - 1);
+        // Two slices may fill one leaf, so the leaves are sized beforehand
+        btree_parallel_for(tasks, [&] (size_t t) {
+            for (auto j = leaves * t / tasks; j < leaves * (t + 1) / tasks; ++j)
+                nodes[j]->_childVals.resize(std::min(target, total - j * group));
+        });
+        btree_parallel_for(tasks, [&] (size_t t) {
+            auto k = starts[t];
+            for (auto i = slice(t); i < slice(t + 1); ++i) {
+                if (!is_new(i))
+                    continue;
+                auto leaf = k / group;
+                auto pos = k % group;
+                if (pos < target)
+                    nodes[leaf]->_childVals[pos] = first[i];
+                if (linked && pos == 0 && leaf > 0)
+                    seps[leaf - 1] = first[i];
+                else if (!linked && pos == target)
+                    seps[leaf] = first[i];
+                ++k;
+            }
+        });
+        build_levels(nodes, seps, cap, target);
+    }
+
+    /**
+     * Sorts [first, last) in place on several threads, see
+     * btree_parallel_sort, then loads it with parallel_assign.
+     */
+    template <typename RandomIt>
+    void parallel_sort_assign(RandomIt first, RandomIt last, unsigned threads = std::thread::hardware_concurrency(),
+                              double fill = 1.0) {
+        btree_parallel_sort(first, last, std::max(threads, 1u), _comp);
+        parallel_assign(first, last, threads, fill);
+    }
+
     /**
      * Puts a breadth-first traversal of the B-Tree onto the output
      * stream os. Elements must, in turn, support the output operator.
@@ -171,7 +741,7 @@ public:
      * @param tree a const reference to a B-Tree object
      * @return a reference to os
      */
-    friend std::ostream& operator<< (std::ostream& os, const btree<T>& tree) {
+    friend std::ostream& operator<< (std::ostream& os, const btree<T, N, Linked, Compare, Mapped>& tree) {
         auto vals = tree._root->bfs();
         std::cout << "There are " << vals.size() << " nodes \n";
         for (auto i = vals.cbegin(); i != vals.cend(); ++i) {
@@ -218,40 +788,29 @@ public:
          return rcend();
      }
 
+     /**
+      * begin() and end() read the cached first and last leaves. The
+      * past-the-end position is one past the values of the last leaf,
+      * so stepping back from it lands on the largest element.
+      */
      const_iterator cend() const {
-         auto pair = findMax(_root);
-         auto dist = pair.first;
-         auto tree = pair.second;
-         auto vec_it = tree->_childVals.begin() + dist;
-         return const_iterator(vec_it, tree, true);
+         return const_iterator(_last->_childVals.end(), _last);
      }
 
      const_iterator cbegin() const {
-         auto pair = findMin(_root);
-         auto dist = pair.first;
-         auto tree = pair.second;
-         auto vec_it = tree->_childVals.begin() + dist;
-         return const_iterator(vec_it, tree);
+         return const_iterator(_first->_childVals.begin(), _first);
      }
      /**
       * Non Const
       */
      iterator end() {
-         auto pair = findMax(_root);
-         auto dist = pair.first;
-         auto tree = pair.second;
-         auto vec_it = tree->_childVals.begin() + dist;
-         return iterator(vec_it, tree, true);
+         return iterator(_last->_childVals.end(), _last);
      };
      const_iterator end() const {
          return cend();
      }
      iterator begin() {
-         auto pair = findMin(_root);
-         auto dist = pair.first;
-         auto tree = pair.second;
-         auto vec_it = tree->_childVals.begin() + dist;
-         return iterator(vec_it, tree);
+         return iterator(_first->_childVals.begin(), _first);
      }
 
      const_iterator begin() const {
@@ -263,20 +822,17 @@ public:
         * not be found.
         *
         * @param elem the client element we are trying to match.    The elem,
-        *                if an instance of a true class, relies on the operator< and
-        *                and operator== methods to compare elem to elements already
+        *                if an instance of a true class, relies on Compare, by default
+        *                its operator<, to compare elem to elements already
         *                in the btree.    You must ensure that your class implements
-        *                these things, else code making use of btree<T>::find will
+        *                it, else code making use of btree<T>::find will
         *                not compile.
         * @return an iterator to the matching element, or whatever the
         *                 non-const end() returns if no such match was ever found.
         */
     iterator find(const T& elem) {
-        auto pair = find(elem, _root);
-        auto dist = pair.first;
-        auto tree = pair.second;
-        auto vec_it = tree->_childVals.begin() + dist;
-        return iterator(vec_it, tree, (*vec_it != elem));
+        btree_path path;
+        return to_iterator(find(elem, _root, path), path);
     };
 
     /**
@@ -289,13 +845,172 @@ public:
         *                 const end() returns if no such match was ever found.
         */
     const_iterator find(const T& elem) const {
-        auto pair = find(elem, _root);
-        auto dist = pair.first;
-        auto tree = pair.second;
-        auto vec_it = tree->_childVals.begin() + dist;
-        return const_iterator(vec_it, tree, (*vec_it != elem));
+        btree_path path;
+        return to_iterator(find(elem, _root, path), path);
     };
 
+    /**
+        * Returns an iterator to the first element not less than elem, or
+        * end() if there is none. Together with upper_bound this delimits
+        * ranges of elements, scanned with the returned iterators.
+        *
+        * @param elem the client element to compare against.
+        * @return an iterator to the first element not less than elem.
+        */
+    iterator lower_bound(const T& elem) {
+        btree_path path;
+        return to_iterator(bound(elem, _root, false, path), path);
+    }
+    const_iterator lower_bound(const T& elem) const {
+        btree_path path;
+        return to_iterator(bound(elem, _root, false, path), path);
+    }
+
+    /**
+        * Returns an iterator to the first element greater than elem, or
+        * end() if there is none.
+        *
+        * @param elem the client element to compare against.
+        * @return an iterator to the first element greater than elem.
+        */
+    iterator upper_bound(const T& elem) {
+        btree_path path;
+        return to_iterator(bound(elem, _root, true, path), path);
+    }
+    const_iterator upper_bound(const T& elem) const {
+        btree_path path;
+        return to_iterator(bound(elem, _root, true, path), path);
+    }
+
+    /**
+        * Returns the range of elements equal to elem, as lower_bound and
+        * upper_bound would. Elements are unique, so the range is empty or
+        * holds one element, and a single descent finds both ends.
+        *
+        * @param elem the client element to match.
+        * @return a pair of iterators delimiting the matching elements.
+        */
+    std::pair<iterator, iterator> equal_range(const T& elem) {
+        return range(elem);
+    }
+    std::pair<const_iterator, const_iterator> equal_range(const T& elem) const {
+        return range(elem);
+    }
+
+    /**
+        * With a transparent Compare the lookups above also take a key of
+        * any type Compare orders against T, as std::set's do, and insert
+        * builds a T from the key only once it knows the key is missing.
+        */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key) {
+        btree_path path;
+        return to_iterator(find(key, _root, path), path);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator find(const K& key) const {
+        btree_path path;
+        return to_iterator(find(key, _root, path), path);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K& key) {
+        btree_path path;
+        return to_iterator(bound(key, _root, false, path), path);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator lower_bound(const K& key) const {
+        btree_path path;
+        return to_iterator(bound(key, _root, false, path), path);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upper_bound(const K& key) {
+        btree_path path;
+        return to_iterator(bound(key, _root, true, path), path);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator upper_bound(const K& key) const {
+        btree_path path;
+        return to_iterator(bound(key, _root, true, path), path);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    std::pair<iterator, iterator> equal_range(const K& key) {
+        return range(key);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range(const K& key) const {
+        return range(key);
+    }
+
+    /**
+        * Returns the ordering of the elements.
+        */
+    key_compare key_comp() const {
+        return _comp;
+    }
+
+    /**
+        * Returns the number of elements in the btree, in constant time as
+        * every internal node keeps count of the elements below it.
+        */
+    size_t size() const {
+        return _root->count();
+    }
+
+    /**
+        * Returns the number of elements less than elem, which is the index
+        * elem has in sorted order, or would have if it were inserted.
+        * Descends once, adding up the counts of the subtrees passed over.
+        *
+        * @param elem the client element to rank.
+        * @return the number of elements in the btree less than elem.
+        */
+    size_t rank(const T& elem) const {
+        size_t res = 0;
+        auto current = _root;
+        while (true) {
+            auto &c_nodes = current->_childVals;
+            bool found;
+            auto lower_bound = search(c_nodes, elem, found);
+            size_t subtree_idx = std::distance(c_nodes.begin(), lower_bound);
+            if (current->_leaf)
+                return res + subtree_idx;
+            if (linked) {
+                // a separator, the element is the first of the subtree after it
+                subtree_idx += found;
+            } else {
+                res += subtree_idx;
+            }
+            for (size_t i = 0; i < subtree_idx; ++i)
+                res += current->children()[i]->count();
+            if (found && !linked)
+                return res + current->children()[subtree_idx]->count();
+            current = current->children()[subtree_idx];
+        }
+    }
+
+    /**
+        * Returns an iterator to the element at index idx in sorted order,
+        * the one rank would give idx for. Descends once, skipping over
+        * subtrees by their counts.
+        *
+        * @param idx the index of the element, from 0.
+        * @return an iterator to the element, or end() if idx >= size().
+        */
+    iterator select(size_t idx) {
+        btree_path path;
+        return to_iterator(select(idx, _root, path), path);
+    }
+
+    /**
+        * Identical in functionality to the non-const version of select,
+        * save the fact that what's pointed to by the returned iterator
+        * is deemed as const and immutable.
+        */
+    const_iterator select(size_t idx) const {
+        btree_path path;
+        return to_iterator(select(idx, _root, path), path);
+    }
+
     /**
         * Operation which inserts the specified element
         * into the btree if a matching element isn't already
@@ -315,7 +1030,7 @@ public:
         * The insert method makes use of T's zero-arg constructor and
         * operator= method, and if these things aren't available,
         * then the call to btree<T>::insert will not compile.    The implementation
-        * also makes use of the class's operator== and operator< as well.
+        * also orders elements with Compare, by default the class's operator<.
         *
         * @param elem the element to be inserted.
         * @return a pair whose first field is an iterator positioned at
@@ -324,79 +1039,1077 @@ public:
         *                 because no matching element was there prior to the insert call.
         */
     std::pair<iterator, bool> insert(const T& elem) {
-        return insert(elem, _root);
+        return insert_unique(elem, [&elem] () -> const T& { return elem; });
+    };
+
+    /**
+        * Identical in functionality to insert(const T&), save that elem
+        * is moved into the btree rather than copied, if it is inserted.
+        * This lets the btree hold move-only types.
+        */
+    std::pair<iterator, bool> insert(T&& elem) {
+        return insert_unique(elem, [&elem] () -> T&& { return std::move(elem); });
+    };
+
+    /**
+        * Builds an element from args, then moves it into the btree as
+        * insert(T&&) does. The element is built even if a matching one
+        * is already there, as it is needed to compare against; see
+        * try_emplace to avoid that.
+        *
+        * @param args the arguments to construct the element from.
+        * @return as for insert.
+        */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return insert(T(std::forward<Args>(args)...));
+    }
+
+    /**
+        * Builds an element from args and inserts it, unless an element
+        * matching key is already there, in which case nothing is built.
+        * Useful when key is cheap to make and the element it stands for
+        * is not. The element built must compare equal to key. key need
+        * not be a T when Compare is transparent, so nothing is built for
+        * a key already there.
+        *
+        * @param key a key matching the element to be built.
+        * @param args the arguments to construct the element from.
+        * @return as for insert.
+        */
+    template <typename K, typename... Args>
+    typename std::enable_if<lookup_key<K>::value, std::pair<iterator, bool>>::type
+    try_emplace(const K& key, Args&&... args) {
+        return insert_unique(key, [&args...] () { return T(std::forward<Args>(args)...); });
+    }
+
+    /**
+        * With a transparent Compare, inserts a T built from key unless an
+        * element matching key is already there, see try_emplace.
+        */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<K>::type, T>::value>::type>
+    std::pair<iterator, bool> insert(K&& key) {
+        return insert_unique(key, [&key] () { return T(std::forward<K>(key)); });
+    }
+
+    /**
+        * Inserts elem as insert(elem) does, given a hint that it belongs
+        * just before the element at hint, as std::set::insert does. If it
+        * does, or the hint is end() and elem is the largest, elem goes
+        * straight into its leaf without descending from the root.
+        * Otherwise the hint is ignored.
+        *
+        * @param hint the position elem is expected to go before.
+        * @param elem the element to be inserted.
+        * @return an iterator positioned at elem, or the matching element
+        *                 already in the btree.
+        */
+    iterator insert(const_iterator hint, const T& elem) {
+        return insert_hint(hint, elem);
+    }
+    iterator insert(const_iterator hint, T&& elem) {
+        return insert_hint(hint, std::move(elem));
+    }
+
+    /**
+        * Removes the specified element from the btree if it is present.
+        * A node left with fewer than half its maximum number of elements
+        * borrows one from a sibling through the parent, or is merged with a
+        * sibling when neither has one to spare. The merge can leave the parent
+        * short in turn, so rebalancing continues upward, shrinking the height
+        * when the root is emptied.
+        *
+        * Iterators into the btree other than the one returned by
+        * erase(iterator) are invalidated.
+        *
+        * @param elem the client element to remove.
+        * @return the number of elements removed, 0 or 1.
+        */
+    size_t erase(const T& elem) {
+        auto current = _root;
+        while (true) {
+            auto &c_nodes = current->_childVals;
+            bool found;
+            auto lower_bound = search(c_nodes, elem, found);
+            auto subtree_idx = std::distance(c_nodes.begin(), lower_bound);
+            if(found) {
+                if (!linked || current->_leaf) {
+                    erase(dt_tuple(subtree_idx, current));
+                    return 1;
+                }
+                // a separator, the element is the first of the subtree after it
+                ++subtree_idx;
+            }
+            auto subtree = current->child(subtree_idx);
+            if (!subtree)
+                return 0;
+            current = subtree;
+        }
+    }
+
+    /**
+        * Removes the element the iterator is positioned at.
+        *
+        * @param pos a dereferenceable iterator into this btree.
+        * @return an iterator to the element that followed the removed one,
+        *                 or end() if it was the largest.
+        */
+    iterator erase(iterator pos) {
+        // The element after it takes its index, found without copying it
+        auto idx = rank(*pos._currNode);
+        auto tree = pos._currTree;
+        erase(dt_tuple(std::distance(tree->_childVals.begin(), pos._currNode), tree));
+        return select(idx);
+    }
+    /**
+     * Reports how much memory the tree's node arena has taken from the heap
+     * and how much of it is in use. Slabs are only returned to the heap when
+     * the tree is destroyed.
+     */
+    slab_stats slab_usage() const {
+        if (!_nodes)
+            return slab_stats{0, 0, 0, 0};
+        return _nodes->stats();
+    }
+
+    /**
+     * A read-only view of a btree as it was when snapshot() was called.
+     * It shares the tree's nodes rather than copying them; a later change
+     * to the tree copies only the nodes it touches, and their ancestors,
+     * leaving the view's nodes as they were.
+     *
+     * A view may be read, from any thread, while the tree goes on being
+     * changed. Taking, copying and destroying views count references to
+     * shared nodes, and must be done by the tree's writer, or in step with
+     * it. Views are walked from their root down, and their iterators keep
+     * the whole path, as the writer reuses the parent pointers of shared
+     * nodes for the tree.
+     */
+    class snapshot_view {
+    public:
+        class const_iterator {
+        public:
+            using difference_type = std::ptrdiff_t;
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using pointer = const T*;
+            using reference = const T&;
+
+            reference operator*() const {
+                return _path.back().first->_childVals[_path.back().second];
+            }
+            pointer operator->() const {
+                return &operator*();
+            }
+            bool operator==(const const_iterator& other) const {
+                if (_path.empty() || other._path.empty())
+                    return _path.empty() == other._path.empty();
+                return _path.back() == other._path.back();
+            }
+            bool operator!=(const const_iterator& other) const {
+                return !operator==(other);
+            }
+            const_iterator& operator++() {
+                auto &top = _path.back();
+                if (top.first->_leaf) {
+                    ++top.second;
+                    climb_forward();
+                } else {
+                    // smallest element of the subtree after this one
+                    descend(++top.second, false);
+                }
+                return *this;
+            }
+            const_iterator operator++(int) {
+                auto old_val = *this;
+                operator++();
+                return old_val;
+            }
+            const_iterator& operator--() {
+                if (_path.empty()) {
+                    // back from the end, the largest element
+                    descend_to(_root, true);
+                    return *this;
+                }
+                auto &top = _path.back();
+                if (!top.first->_leaf) {
+                    descend(top.second, true);
+                } else if (top.second > 0) {
+                    --top.second;
+                } else {
+                    // up till we come from a subtree with a value before it
+                    _path.pop_back();
+                    while (!_path.empty() && _path.back().second == 0)
+                        _path.pop_back();
+                    if (!_path.empty())
+                        --_path.back().second;
+                }
+                return *this;
+            }
+            const_iterator operator--(int) {
+                auto old_val = *this;
+                operator--();
+                return old_val;
+            }
+        private:
+            friend class snapshot_view;
+            using step = std::pair<const bnode*, size_t>;
+
+            explicit const_iterator(const bnode* root) : _root(root) {}
+            /**
+             * Goes down to the leftmost, or rightmost, element below the
+             * subtree at idx of the current node.
+             */
+            void descend(size_t idx, bool rightmost) {
+                descend_to(_path.back().first->children()[idx], rightmost);
+            }
+            void descend_to(const bnode* node, bool rightmost) {
+                while (true) {
+                    auto size = node->_childVals.size();
+                    if (node->_leaf) {
+                        _path.emplace_back(node, rightmost ? size - 1 : 0);
+                        return;
+                    }
+                    _path.emplace_back(node, rightmost ? size : 0);
+                    node = node->children()[rightmost ? size : 0];
+                }
+            }
+            /**
+             * Past the last value of a leaf, goes up till we come from a
+             * subtree with a value after it, or to the end if there is none.
+             */
+            void climb_forward() {
+                while (!_path.empty() && _path.back().second == _path.back().first->_childVals.size())
+                    _path.pop_back();
+            }
+
+            const bnode* _root;
+            // Each node from the root down with, above the last, the index of
+            // the subtree below it taken, and for the last the element's index
+            std::vector<step> _path;
+        };
+        using iterator = const_iterator;
+
+        snapshot_view(const snapshot_view& other) : _nodes(other._nodes), _root(other._root), _comp(other._comp) {
+            ++_root->_refs;
+        }
+        snapshot_view(snapshot_view&& other) : _nodes(std::move(other._nodes)), _root(other._root), _comp(other._comp) {
+            other._root = nullptr;
+        }
+        snapshot_view& operator=(snapshot_view other) {
+            std::swap(_nodes, other._nodes);
+            std::swap(_root, other._root);
+            std::swap(_comp, other._comp);
+            return *this;
+        }
+        ~snapshot_view() {
+            if (_root)
+                unref(*_nodes, _root);
+        }
+
+        const_iterator begin() const {
+            const_iterator res(_root);
+            if (!_root->_childVals.empty())
+                res.descend_to(_root, false);
+            return res;
+        }
+        const_iterator end() const {
+            return const_iterator(_root);
+        }
+        size_t size() const {
+            return _root->count();
+        }
+        bool empty() const {
+            return _root->_childVals.empty();
+        }
+        /**
+         * As the btree's find, lower_bound and upper_bound.
+         */
+        const_iterator find(const T& elem) const {
+            auto res = lower_bound(elem);
+            if (res != end() && _comp(elem, *res))
+                return end();
+            return res;
+        }
+        const_iterator lower_bound(const T& elem) const {
+            return bound(elem, false);
+        }
+        const_iterator upper_bound(const T& elem) const {
+            return bound(elem, true);
+        }
+    private:
+        friend class btree;
+
+        snapshot_view(std::shared_ptr<node_arena> nodes, bnode* root, const Compare& comp) :
+        _nodes(std::move(nodes)), _root(root), _comp(comp) {
+            ++_root->_refs;
+        }
+        const_iterator bound(const T& elem, bool upper) const {
+            const_iterator res(_root);
+            auto current = _root;
+            while (true) {
+                auto &c_nodes = current->_childVals;
+                bool found;
+                auto idx = btree_search(c_nodes.data(), c_nodes.size(), elem, _comp, found);
+                if (found) {
+                    res._path.emplace_back(current, idx);
+                    if (upper)
+                        ++res;
+                    return res;
+                }
+                res._path.emplace_back(current, idx);
+                if (current->_leaf) {
+                    res.climb_forward();
+                    return res;
+                }
+                current = current->children()[idx];
+            }
+        }
+
+        std::shared_ptr<node_arena> _nodes;
+        bnode* _root;
+        Compare _comp;
     };
+
+    /**
+     * Returns a view of the btree as it is now, in constant time, see
+     * snapshot_view. Leaf-linked trees cannot share their leaves, which
+     * point at each other, and maps are not supported.
+     */
+    snapshot_view snapshot() const {
+        static_assert(shareable, "snapshots are of classic sets of copyable elements");
+        return snapshot_view(_nodes, _root, _comp);
+    }
+
+private:
     /**
      * Inserts element to a subtree, used to be recursive, now it's iterative.
+     * Descends to the leaf the element belongs in and inserts it there; a leaf
+     * that overflows is split and its median promoted, which may in turn split
+     * the parent, all the way up to the root. Every leaf therefore stays at the
+     * same depth and the height is O(log n) whatever the insertion order.
      * If found returns a tuple, the iterator and a bool.
+     *
+     * elem is only compared against, what is inserted is whatever make()
+     * returns, and make is only called if nothing matches elem. A map's
+     * mapped value comes from make_mapped() in the same way.
      */
-    std::pair<iterator, bool> insert(const T& elem, std::shared_ptr<bnode> node) {
-        auto current = node;
+    template <typename K, typename Make, typename MakeMapped = empty_slot (*)()>
+    std::pair<iterator, bool> insert_unique(const K& elem, Make&& make, MakeMapped&& make_mapped = no_value) {
+        // Ascending input goes straight to the end of the last leaf
+        auto &last_vals = _last->_childVals;
+        if (!last_vals.empty() && _comp(last_vals.back(), elem))
+            return std::make_pair(insert_at(_last, last_vals.size(), make(), make_mapped()), true);
+        auto current = _root;
         while (true) {
             auto &c_nodes = current->_childVals;
-            auto &c_trees = current->_childTrees;
-            auto lower_bound = std::lower_bound(c_nodes.begin(), c_nodes.end(), elem);
+            bool found;
+            auto lower_bound = search(c_nodes, elem, found);
             auto subtree_idx = std::distance(c_nodes.begin(), lower_bound);
-            auto &subtree     = c_trees[subtree_idx];
-            if(lower_bound != c_nodes.end()) {
-                if(*lower_bound == elem){
+            if(found){
+                if (!linked || current->_leaf)
                     return std::make_pair<iterator, bool>({lower_bound, current}, false);
+                ++subtree_idx;
+            }
+            auto subtree     = current->child(subtree_idx);
+            if(!subtree)
+                return std::make_pair(insert_at(current, subtree_idx, make(), make_mapped()), true);
+            current = subtree;
+        }
+        return std::make_pair<iterator, bool>(end(), false);
+    }
+    /**
+     * The hinted insert, see insert(const_iterator, const T&).
+     */
+    template <typename V>
+    iterator insert_hint(const_iterator hint, V&& elem) {
+        auto node = hint._currTree;
+        size_t idx = std::distance(node->_childVals.begin(), hint._currNode);
+        auto fits = hint == cend() || _comp(elem, *hint._currNode);
+        if (fits && hint != cbegin()) {
+            auto before = hint;
+            --before;
+            fits = _comp(*before._currNode, elem);
+            // A leaf-linked leaf's separator may lie anywhere between the
+            // element before it and its first, so either leaf could be right
+            if (linked && idx == 0)
+                fits = false;
+        }
+        if (!fits)
+            return insert(std::forward<V>(elem)).first;
+        // Just before an internal element is just after its predecessor
+        if (!node->_leaf) {
+            auto pred = findMax(node->children()[idx]);
+            node = pred.second;
+            idx = pred.first + 1;
+        }
+        return insert_at(node, idx, std::forward<V>(elem));
+    }
+    /**
+     * Inserts elem into a leaf at idx, which must be where it sorts, then
+     * splits the leaf if it overflows, all the way up to the root.
+     */
+    template <typename V, typename W = empty_slot>
+    iterator insert_at(bnode* leaf, size_t idx, V&& elem, W&& mapped = W()) {
+        leaf = own(leaf);
+        // Leaf, values have room for one extra element before splitting
+        leaf->_childVals.insert(leaf->_childVals.begin() + idx, std::forward<V>(elem));
+        if (holds_mapped(leaf))
+            leaf->_mapped.insert(leaf->_mapped.begin() + idx, std::forward<W>(mapped));
+        add_count(leaf, 1);
+        auto pos = dt_tuple(idx, leaf);
+        for (auto current = leaf; current->_childVals.size() > current->_size; current = current->_parent)
+            split(current, pos);
+        return convert_tuple(pos);
+    }
+    /**
+     * Splits an overflowing node (one holding _size + 1 values) in two around
+     * its median, which is pushed up into the parent. A new root is grown if
+     * the node has no parent. A leaf of a leaf-linked tree keeps the median
+     * as the first value of the new sibling and only a copy goes up.
+     * pos tracks the element just inserted, and is updated if it moves.
+     */
+    void split(bnode* node, dt_tuple &pos) {
+        auto &n_vals = node->_childVals;
+        auto mid = n_vals.size() / 2;
+        auto parent = node->_parent;
+        if (!parent) {
+            parent = _nodes->make_inode(node->_size);
+            parent->children()[0] = node;
+            node->_parent = parent;
+            _root = parent;
+        }
+        auto sibling = node->_leaf ? _nodes->make(node->_size, parent) : _nodes->make_inode(node->_size, parent);
+        if (node == _last)
+            _last = sibling;
+        auto copy_up = linked && node->_leaf;
+        if (copy_up) {
+            link(sibling, node->next_leaf());
+            link(node, sibling);
+        }
+        // Right half of the values and subtrees go to the new sibling
+        std::move(n_vals.begin() + mid + !copy_up, n_vals.end(), std::back_inserter(sibling->_childVals));
+        auto &n_mapped = node->_mapped;
+        if (holds_mapped(node))
+            std::move(n_mapped.begin() + mid + !copy_up, n_mapped.end(), std::back_inserter(sibling->_mapped));
+        if (!node->_leaf) {
+            auto &n_trees = node->children();
+            for (auto i = mid + 1; i < n_trees.size(); ++i) {
+                if (!n_trees[i])
+                    continue;
+                n_trees[i]->_parent = sibling;
+                sibling->children()[i - mid - 1] = n_trees[i];
+                n_trees[i] = nullptr;
+            }
+            n_trees.resize(node->_size + 1);
+        }
+        // Median goes just after node in the parent
+        auto &p_vals = parent->_childVals;
+        auto &p_trees = parent->children();
+        auto node_idx = std::distance(p_trees.begin(), std::find(p_trees.begin(), p_trees.end(), node));
+        if (copy_up)
+            p_vals.insert(p_vals.begin() + node_idx, separator(sibling->_childVals.front()));
+        else
+            p_vals.insert(p_vals.begin() + node_idx, std::move(n_vals[mid]));
+        if (!copy_up && holds_mapped(parent))
+            parent->_mapped.insert(parent->_mapped.begin() + node_idx, std::move(n_mapped[mid]));
+        p_trees.insert(p_trees.begin() + node_idx + 1, sibling);
+        if (!p_trees.back())
+            p_trees.pop_back();
+        n_vals.erase(n_vals.begin() + mid, n_vals.end());
+        if (holds_mapped(node))
+            n_mapped.erase(n_mapped.begin() + mid, n_mapped.end());
+
+        recount(node);
+        recount(sibling);
+        recount(parent);
+
+        if (copy_up && pos.second == node && pos.first >= mid) {
+            pos = dt_tuple(pos.first - mid, sibling);
+        } else if (pos.second == node && pos.first == mid) {
+            pos = dt_tuple(node_idx, parent);
+        } else if (pos.second == node && pos.first > mid) {
+            pos = dt_tuple(pos.first - mid - 1, sibling);
+        }
+    }
+    /**
+     * Removes the value at a position. An internal value is overwritten with
+     * its in-order predecessor so the removal always happens in a leaf, which
+     * is then rebalanced.
+     */
+    void erase(dt_tuple pos) {
+        auto node = own(pos.second);
+        auto left_subtree = node->child(pos.first);
+        if (left_subtree) {
+            auto pred = findMax(left_subtree);
+            pred.second = own(pred.second);
+            node->_childVals[pos.first] = std::move(pred.second->_childVals[pred.first]);
+            if (holds_mapped(node))
+                node->_mapped[pos.first] = std::move(pred.second->_mapped[pred.first]);
+            pos = pred;
+            node = pred.second;
+        }
+        node->_childVals.erase(node->_childVals.begin() + pos.first);
+        if (holds_mapped(node))
+            node->_mapped.erase(node->_mapped.begin() + pos.first);
+        add_count(node, -1);
+        rebalance(node);
+    }
+    /**
+     * Restores the minimum fill of a node after a removal by borrowing from
+     * or merging with a sibling, walking up while parents underflow.
+     */
+    void rebalance(bnode* node) {
+        auto min_size = node->_size / 2;
+        while (node != _root && node->_childVals.size() < min_size) {
+            auto parent = node->_parent;
+            auto &p_trees = parent->children();
+            size_t idx = std::distance(p_trees.begin(), std::find(p_trees.begin(), p_trees.end(), node));
+            auto left = idx > 0 ? p_trees[idx - 1] : nullptr;
+            auto right = idx < parent->_childVals.size() ? p_trees[idx + 1] : nullptr;
+            if (left && left->_childVals.size() > min_size) {
+                rotate_right(parent, idx - 1);
+                return;
+            }
+            if (right && right->_childVals.size() > min_size) {
+                rotate_left(parent, idx);
+                return;
+            }
+            if (left)
+                merge(parent, idx - 1);
+            else
+                merge(parent, idx);
+            node = parent;
+        }
+        if (_root->_childVals.empty() && !_root->_leaf) {
+            auto old_root = _root;
+            _root = _root->children()[0];
+            _root->_parent = nullptr;
+            _nodes->release(old_root);
+        }
+    }
+    /**
+     * Moves the separator at idx down into the right child, and the left
+     * child's largest value (and last subtree) up to replace it.
+     * Leaves of a leaf-linked tree pass the value across directly, the
+     * separator becomes a copy of it.
+     */
+    void rotate_right(bnode* parent, size_t idx) {
+        auto left = own(parent->children()[idx]);
+        auto right = own(parent->children()[idx + 1]);
+        auto &l_vals = left->_childVals;
+        auto &l_mapped = left->_mapped;
+        if (holds_mapped(left)) {
+            // the mapped values follow the keys, a leaf-linked parent has none
+            auto &r_mapped = right->_mapped;
+            if (linked) {
+                r_mapped.insert(r_mapped.begin(), std::move(l_mapped.back()));
+            } else {
+                r_mapped.insert(r_mapped.begin(), std::move(parent->_mapped[idx]));
+                parent->_mapped[idx] = std::move(l_mapped.back());
+            }
+            l_mapped.pop_back();
+        }
+        if (linked && left->_leaf) {
+            right->_childVals.insert(right->_childVals.begin(), std::move(l_vals.back()));
+            parent->_childVals[idx] = separator(right->_childVals.front());
+            l_vals.pop_back();
+            return;
+        }
+        right->_childVals.insert(right->_childVals.begin(), std::move(parent->_childVals[idx]));
+        parent->_childVals[idx] = std::move(l_vals.back());
+        if (!left->_leaf) {
+            auto &r_trees = right->children();
+            auto &moved = left->children()[l_vals.size()];
+            moved->_parent = right;
+            r_trees.insert(r_trees.begin(), moved);
+            r_trees.pop_back();
+            moved = nullptr;
+        }
+        l_vals.pop_back();
+        recount(left);
+        recount(right);
+    }
+    /**
+     * Moves the separator at idx down into the left child, and the right
+     * child's smallest value (and first subtree) up to replace it.
+     */
+    void rotate_left(bnode* parent, size_t idx) {
+        auto left = own(parent->children()[idx]);
+        auto right = own(parent->children()[idx + 1]);
+        auto &r_vals = right->_childVals;
+        auto &l_vals = left->_childVals;
+        if (holds_mapped(left)) {
+            auto &r_mapped = right->_mapped;
+            if (linked) {
+                left->_mapped.push_back(std::move(r_mapped.front()));
+            } else {
+                left->_mapped.push_back(std::move(parent->_mapped[idx]));
+                parent->_mapped[idx] = std::move(r_mapped.front());
+            }
+            r_mapped.erase(r_mapped.begin());
+        }
+        if (linked && left->_leaf) {
+            l_vals.push_back(std::move(r_vals.front()));
+            r_vals.erase(r_vals.begin());
+            parent->_childVals[idx] = separator(r_vals.front());
+            return;
+        }
+        l_vals.push_back(std::move(parent->_childVals[idx]));
+        parent->_childVals[idx] = std::move(r_vals.front());
+        if (!right->_leaf) {
+            auto &r_trees = right->children();
+            r_trees[0]->_parent = left;
+            left->children()[l_vals.size()] = r_trees[0];
+            r_trees.erase(r_trees.begin());
+            r_trees.emplace_back();
+        }
+        r_vals.erase(r_vals.begin());
+        recount(left);
+        recount(right);
+    }
+    /**
+     * Merges the right child of the separator at idx into the left child,
+     * pulling the separator down between them. Leaves of a leaf-linked tree
+     * drop the separator, and the right one leaves the chain.
+     */
+    void merge(bnode* parent, size_t idx) {
+        auto left = own(parent->children()[idx]);
+        auto right = own(parent->children()[idx + 1]);
+        auto &l_vals = left->_childVals;
+        auto offset = l_vals.size() + 1;
+        if (linked && left->_leaf)
+            link(left, right->next_leaf());
+        else
+            l_vals.push_back(std::move(parent->_childVals[idx]));
+        std::move(right->_childVals.begin(), right->_childVals.end(), std::back_inserter(l_vals));
+        if (holds_mapped(left)) {
+            auto &l_mapped = left->_mapped;
+            if (!linked) {
+                l_mapped.push_back(std::move(parent->_mapped[idx]));
+                parent->_mapped.erase(parent->_mapped.begin() + idx);
+            }
+            std::move(right->_mapped.begin(), right->_mapped.end(), std::back_inserter(l_mapped));
+        }
+        for (size_t i = 0; !right->_leaf && i <= right->_childVals.size(); ++i) {
+            auto subtree = right->children()[i];
+            subtree->_parent = left;
+            left->children()[offset + i] = subtree;
+        }
+        auto &p_trees = parent->children();
+        parent->_childVals.erase(parent->_childVals.begin() + idx);
+        p_trees.erase(p_trees.begin() + idx + 1);
+        p_trees.emplace_back();
+        if (right == _last)
+            _last = left;
+        recount(left);
+        _nodes->release(right);
+    }
+    /**
+     * Hands a node and all its subtrees back to the arena.
+     */
+    void destroy(bnode* node) {
+        unref(*_nodes, node);
+    }
+    /**
+     * Drops a reference to a node, handing it and the subtrees only it
+     * referred to back to the arena once no tree or snapshot refers to it.
+     */
+    static void unref(node_arena &arena, bnode* node) {
+        if (--node->_refs > 0)
+            return;
+        for (size_t i = 0; !node->_leaf && i <= node->_childVals.size(); ++i)
+            unref(arena, node->children()[i]);
+        arena.release(node);
+    }
+    /**
+     * Makes node, and each node above it, belong to this tree alone before
+     * it is changed, copying those a snapshot still shares. A copy takes
+     * the place of the shared node in the parent, and shares the node's
+     * subtrees in turn. Returns the node to change, the copy if one was made.
+     *
+     * Only nodes of this tree have their _parent kept: the writer sets the
+     * _parent of shared nodes as it needs, snapshots never read it.
+     */
+    bnode* own(bnode* node) {
+        return own(node, std::integral_constant<bool, shareable>());
+    }
+    bnode* own(bnode* node, std::false_type) {
+        return node;
+    }
+    bnode* own(bnode* node, std::true_type) {
+        // Nothing is shared while no snapshot holds the arena
+        if (_nodes.use_count() == 1)
+            return node;
+        auto parent = node->_parent;
+        if (parent)
+            parent = own(parent, std::true_type());
+        if (node->_refs == 1)
+            return node;
+        auto res = node->_leaf ? _nodes->make(node->_size, parent) : _nodes->make_inode(node->_size, parent);
+        res->_childVals = node->_childVals;
+        res->_mapped = node->_mapped;
+        if (!node->_leaf) {
+            static_cast<inode*>(res)->_count = node->count();
+            for (size_t i = 0; i <= node->_childVals.size(); ++i) {
+                auto subtree = node->children()[i];
+                ++subtree->_refs;
+                subtree->_parent = res;
+                res->children()[i] = subtree;
+            }
+        }
+        if (parent) {
+            auto &p_trees = parent->children();
+            *std::find(p_trees.begin(), p_trees.end(), node) = res;
+        } else {
+            _root = res;
+        }
+        if (node == _first)
+            _first = res;
+        if (node == _last)
+            _last = res;
+        --node->_refs;
+        return res;
+    }
+    /**
+     * fix_last for the leaves of a leaf-linked tree, whose separators are
+     * copies of the first value of the leaf after them.
+     */
+    void fix_last_leaf(std::vector<bnode*> &nodes, std::vector<T> &seps) {
+        auto left = nodes[nodes.size() - 2];
+        auto right = nodes.back();
+        auto &l_vals = left->_childVals;
+        auto &r_vals = right->_childVals;
+        auto total = l_vals.size() + r_vals.size();
+        if (total <= left->_size) {
+            std::move(r_vals.begin(), r_vals.end(), std::back_inserter(l_vals));
+            link(left, nullptr);
+            _nodes->release(right);
+            nodes.pop_back();
+            seps.pop_back();
+            return;
+        }
+        while (r_vals.size() < total - total / 2) {
+            r_vals.insert(r_vals.begin(), std::move(l_vals.back()));
+            l_vals.pop_back();
+        }
+        seps.back() = r_vals.front();
+    }
+    /**
+     * Whether a node keeps mapped values beside its keys: every node of a
+     * map, save the internal nodes of a leaf-linked one, whose keys are
+     * only copies separating the leaves.
+     */
+    static bool holds_mapped(const bnode* node) {
+        return is_map && (!linked || node->_leaf);
+    }
+    /**
+     * The mapped value of a set's element, which is nothing.
+     */
+    static empty_slot no_value() {
+        return empty_slot();
+    }
+    /**
+     * A copy of val to serve as a separator of a leaf-linked tree. Other
+     * trees only ever move their values around, this is never called for
+     * them, and they do not need T to be copyable.
+     */
+    template <bool L = Linked, typename std::enable_if<L, int>::type = 0>
+    static T separator(const T& val) {
+        return val;
+    }
+    template <bool L = Linked, typename std::enable_if<!L, int>::type = 0>
+    static T separator(const T&) {
+        return T();
+    }
+    /**
+     * Adds delta to the element count of every internal node above node.
+     */
+    static void add_count(bnode* node, std::ptrdiff_t delta) {
+        for (auto parent = node->_parent; parent; parent = parent->_parent)
+            static_cast<inode*>(parent)->_count += delta;
+    }
+    /**
+     * Recomputes the element count of an internal node from its own values
+     * and its subtrees' counts. Separators of a leaf-linked tree are copies
+     * and not counted.
+     */
+    static void recount(bnode* node) {
+        if (node->_leaf)
+            return;
+        size_t count = linked ? 0 : node->_childVals.size();
+        for (size_t i = 0; i <= node->_childVals.size(); ++i)
+            count += node->children()[i]->count();
+        static_cast<inode*>(node)->_count = count;
+    }
+    /**
+     * Recounts every internal node under node, subtrees first.
+     */
+    static void recount_all(bnode* node) {
+        for (size_t i = 0; !node->_leaf && i <= node->_childVals.size(); ++i)
+            recount_all(node->children()[i]);
+        recount(node);
+    }
+    /**
+     * Makes right follow left in the leaf chain of a leaf-linked tree,
+     * either may be null.
+     */
+    static void link(bnode* left, bnode* right) {
+        if (left)
+            left->set_next(right);
+        if (right)
+            right->set_prev(left);
+    }
+    /**
+     * Chains the leaves under node in order, after prev, which is left
+     * at the last of them.
+     */
+    static void link_leaves(bnode* node, bnode*& prev) {
+        if (node->_leaf) {
+            link(prev, node);
+            prev = node;
+            return;
+        }
+        for (size_t i = 0; i <= node->_childVals.size(); ++i)
+            link_leaves(node->children()[i], prev);
+    }
+    /**
+     * Finds the first and last leaves again once the tree has been rebuilt.
+     */
+    void find_ends() {
+        _first = _last = _root;
+        while (!_first->_leaf)
+            _first = _first->children().front();
+        while (!_last->_leaf)
+            _last = _last->children()[_last->_childVals.size()];
+    }
+    /**
+     * Bulk load helper. Builds the levels above a packed leaf level, nodes
+     * with seps between them, and makes the top one the root.
+     */
+    void build_levels(std::vector<bnode*> &nodes, std::vector<T> &seps, size_t cap, size_t target) {
+        // Each pass groups a level under a new level of parents
+        fix_last(nodes, seps);
+        while (nodes.size() > 1) {
+            std::vector<bnode*> parents;
+            std::vector<T> up_seps;
+            auto parent = _nodes->make_inode(cap);
+            adopt(parent, 0, nodes[0]);
+            for (size_t i = 0; i < seps.size(); ++i) {
+                auto &p_vals = parent->_childVals;
+                if (p_vals.size() < target) {
+                    p_vals.push_back(std::move(seps[i]));
+                    adopt(parent, p_vals.size(), nodes[i + 1]);
+                } else {
+                    up_seps.push_back(std::move(seps[i]));
+                    parents.push_back(parent);
+                    parent = _nodes->make_inode(cap);
+                    adopt(parent, 0, nodes[i + 1]);
                 }
             }
-            if(c_nodes.size() < current->_size) {
-                auto elem_it = c_nodes.insert(lower_bound, elem);
-                return std::make_pair<iterator, bool>({elem_it, current}, true);
+            parents.push_back(parent);
+            nodes.swap(parents);
+            seps.swap(up_seps);
+            fix_last(nodes, seps);
+        }
+        _root = nodes[0];
+        find_ends();
+        recount_all(_root);
+    }
+    /**
+     * The number of values a bulk load packs into each node, filling a
+     * fraction of its capacity but at least half.
+     */
+    static size_t fill_target(size_t cap, double fill) {
+        auto target = static_cast<size_t>(cap * fill + 0.5);
+        return std::max(std::min(target, cap), std::max<size_t>(cap / 2, 1));
+    }
+    /**
+     * Hangs child off parent as its subtree at idx.
+     */
+    static void adopt(bnode* parent, size_t idx, bnode* child) {
+        child->_parent = parent;
+        parent->children()[idx] = child;
+    }
+    /**
+     * Bulk load helper. The last node of a level is whatever was left over
+     * and may be under half full, so it is merged into its left neighbour
+     * or takes values off it, the same way erase rebalances.
+     */
+    void fix_last(std::vector<bnode*> &nodes, std::vector<T> &seps) {
+        if (nodes.size() < 2)
+            return;
+        auto left = nodes[nodes.size() - 2];
+        auto right = nodes.back();
+        auto &l_vals = left->_childVals;
+        auto &r_vals = right->_childVals;
+        size_t cap = left->_size;
+        if (r_vals.size() >= cap / 2 && !r_vals.empty())
+            return;
+        if (linked && left->_leaf) {
+            fix_last_leaf(nodes, seps);
+            return;
+        }
+        auto total = l_vals.size() + r_vals.size() + 1;
+        auto offset = l_vals.size() + 1;
+        if (total <= cap) {
+            l_vals.push_back(std::move(seps.back()));
+            std::move(r_vals.begin(), r_vals.end(), std::back_inserter(l_vals));
+            for (size_t i = 0; !right->_leaf && i <= r_vals.size(); ++i)
+                adopt(left, offset + i, right->children()[i]);
+            _nodes->release(right);
+            nodes.pop_back();
+            seps.pop_back();
+            return;
+        }
+        // Rotate values (and subtrees) right until both halves are even
+        auto &sep = seps.back();
+        while (r_vals.size() < (total - 1) - (total - 1) / 2) {
+            r_vals.insert(r_vals.begin(), std::move(sep));
+            sep = std::move(l_vals.back());
+            if (!left->_leaf) {
+                auto &r_trees = right->children();
+                auto &moved = left->children()[l_vals.size()];
+                moved->_parent = right;
+                r_trees.insert(r_trees.begin(), moved);
+                r_trees.pop_back();
+                moved = nullptr;
+            }
+            l_vals.pop_back();
+        }
+    }
+    /**
+     * Finds the first of a node's values not less than elem, setting found
+     * if it equals elem, see btree_search.h.
+     */
+    template <typename Vals, typename K>
+    auto search(Vals& vals, const K& elem, bool& found) const -> decltype(vals.begin()) {
+        return vals.begin() + btree_search(vals.data(), vals.size(), elem, _comp, found);
+    }
+    /**
+     * Finds the first element not less than elem in a given subtree, or if
+     * upper is set the first element greater than it.
+     * The returned tuple holds a null node if every element is smaller.
+     * In a leaf-linked tree only the leaves hold elements, it is either in
+     * the leaf elem belongs in or first in the one after it.
+     * The children taken down to the element are recorded in path; a
+     * leaf-linked tree's iterators never climb, so it records none.
+     */
+    template <typename K>
+    dt_tuple bound(const K& elem, bnode* node, bool upper, btree_path& path) const {
+        auto current = node;
+        auto res = dt_tuple(0, nullptr);
+        while (linked && !current->_leaf) {
+            auto &c_nodes = current->_childVals;
+            bool found;
+            auto lower_bound = search(c_nodes, elem, found);
+            auto subtree_idx = std::distance(c_nodes.begin(), lower_bound) + found;
+            current = current->children()[subtree_idx];
+        }
+        if (linked) {
+            auto &c_nodes = current->_childVals;
+            bool found;
+            auto lower_bound = search(c_nodes, elem, found);
+            size_t idx = std::distance(c_nodes.begin(), lower_bound);
+            if (upper && found)
+                ++idx;
+            if (idx < c_nodes.size())
+                return dt_tuple(idx, current);
+            auto next = current->next_leaf();
+            return next ? dt_tuple(0, next) : res;
+        }
+        // the answer can be above where the descent ends, the levels taken
+        // below it are dropped from the path again
+        size_t levels = 0, res_levels = 0;
+        while (current) {
+            auto &c_nodes = current->_childVals;
+            bool found;
+            auto lower_bound = search(c_nodes, elem, found);
+            size_t subtree_idx = std::distance(c_nodes.begin(), lower_bound);
+            if (found) {
+                if (!upper)
+                    return dt_tuple(subtree_idx, current);
+                // everything after it is greater, down to the leaves
+                ++subtree_idx;
+            }
+            if (subtree_idx < c_nodes.size()) {
+                res = dt_tuple(subtree_idx, current);
+                res_levels = levels;
             }
-            if(!subtree) {
-                subtree = std::make_shared<bnode>(bnode(current->_size, current));
+            if (!current->_leaf) {
+                path.push(subtree_idx, current->_size);
+                ++levels;
             }
-            current = subtree;
+            current = current->child(subtree_idx);
         }
-        return std::make_pair<iterator, bool>(end(), false);
+        for (size_t idx; levels > res_levels; --levels)
+            path.pop(node->_size, idx);
+        return res;
     }
     /**
-     * Finds an element in a given subtree
+     * Finds the element at index idx of a given subtree, recording the
+     * children taken in path.
+     * The returned tuple holds a null node if the subtree is smaller.
      */
-    dt_tuple find(const T& elem, std::shared_ptr<bnode> node) const {
+    dt_tuple select(size_t idx, bnode* node, btree_path& path) const {
+        if (idx >= node->count())
+            return dt_tuple(0, nullptr);
+        auto current = node;
+        while (!current->_leaf) {
+            size_t i = 0;
+            for (;; ++i) {
+                auto subtree_count = current->children()[i]->count();
+                if (idx < subtree_count)
+                    break;
+                idx -= subtree_count;
+                if (!linked && idx-- == 0)
+                    return dt_tuple(i, current);
+            }
+            path.push(i, current->_size);
+            current = current->children()[i];
+        }
+        return dt_tuple(idx, current);
+    }
+    /**
+     * Finds an element in a given subtree, recording the children taken
+     * in path.
+     * The returned tuple holds a null node if it is not there.
+     */
+    template <typename K>
+    dt_tuple find(const K& elem, bnode* node, btree_path& path) const {
         auto current = node;
         while (true) {
-            auto c_nodes = current->_childVals;
-            auto c_trees = current->_childTrees;
+            // References only, a lookup never copies a node's vectors
+            auto &c_nodes = current->_childVals;
             // There are n nodes
             // There are n + 1 subtrees
             // Lower bound finds the first iterator in iterator that is >= a given value
             // If not found, it returns the end iterator
             // distance(nodes.begin, nodes.end) = n (since the ending iterator goes past the actual end)
             // Thus if we have to look at a subtree, distance(nodes.begin, lower_bound) will always give the only possible subtree that the element is in
-            auto lower_bound = std::lower_bound(c_nodes.begin(), c_nodes.end(), elem);
+            bool found;
+            auto lower_bound = search(c_nodes, elem, found);
             auto subtree_idx = std::distance(c_nodes.begin(), lower_bound);
-            if(lower_bound != c_nodes.end()) {
-                if(*lower_bound == elem) {
+            if(found) {
+                if (!linked || current->_leaf)
                     return dt_tuple(subtree_idx , current);
-                }
+                ++subtree_idx;
             }
-            auto &subtree = c_trees[subtree_idx];
-            if (subtree)
-                current = subtree;
-            else
+            auto subtree = current->child(subtree_idx);
+            if (!subtree)
                 break;
+            path.push(subtree_idx, current->_size);
+            current = subtree;
         }
-        return findMax(_root);
+        return dt_tuple(0, nullptr);
     };
     /**
-     * Helper functions, one finds local minimum and the other find local maximum in a subtree
+     * Helper function, finds the local maximum in a subtree
      */
-    friend dt_tuple findMin(std::shared_ptr<bnode> node) {
-        auto dist = 0;
-        auto first_subtree = node->_childTrees[dist];
-        if(first_subtree)
-           return(findMin(first_subtree));
-        return dt_tuple(dist, node);
-    }
-
-    friend dt_tuple findMax(std::shared_ptr<bnode> node) {
+    friend dt_tuple findMax(bnode* node) {
         auto dist = std::distance(std::begin(node->_childVals), std::end(node->_childVals));
-        auto final_subtree = node->_childTrees[dist];
+        auto final_subtree = node->child(dist);
         if(final_subtree)
            return findMax(final_subtree);
         return dt_tuple(dist - 1, node);
@@ -408,6 +2121,42 @@ public:
         auto vec_it = tree->_childVals.begin() + dist;
         return iterator(vec_it, tree);
     }
+    /**
+     * As convert_tuple, for a node reached from the root by path, or end()
+     * for a tuple holding a null node.
+     */
+    iterator to_iterator(dt_tuple pair, const btree_path& path) {
+        if (!pair.second)
+            return end();
+        return iterator(pair.second->_childVals.begin() + pair.first, pair.second, path);
+    }
+    const_iterator to_iterator(dt_tuple pair, const btree_path& path) const {
+        if (!pair.second)
+            return end();
+        return const_iterator(pair.second->_childVals.begin() + pair.first, pair.second, path);
+    }
+    /**
+     * The elements matching elem, see equal_range.
+     */
+    template <typename K>
+    std::pair<iterator, iterator> range(const K& elem) {
+        btree_path path;
+        auto first = to_iterator(bound(elem, _root, false, path), path);
+        auto last = first;
+        if (last != end() && !_comp(elem, *last._currNode))
+            ++last;
+        return std::make_pair(first, last);
+    }
+    template <typename K>
+    std::pair<const_iterator, const_iterator> range(const K& elem) const {
+        btree_path path;
+        auto first = to_iterator(bound(elem, _root, false, path), path);
+        auto last = first;
+        if (last != end() && !_comp(elem, *last._currNode))
+            ++last;
+        return std::make_pair(first, last);
+    }
+public:
     /**
         * Disposes of all internal resources, which includes
         * the disposal of any client objects previously
@@ -415,8 +2164,15 @@ public:
         * Check that your implementation does not leak memory!
         */
     ~btree() {
-        _root.reset();
+        if (_root)
+            destroy(_root);
     }
 };
 
+/**
+ * A btree in its leaf-linked (B+tree) form, see btree.
+ */
+template <typename T, size_t N = 0, typename Compare = std::less<T>>
+using linked_btree = btree<T, N, true, Compare>;
+
 #endif
@@ -0,0 +1,219 @@
+/**
+ * Epoch-based reclamation for the nodes of the concurrent btree.
+ *
+ * Readers that take no locks may still be inside a node after a writer has
+ * taken it out of the tree, so the writer cannot free it there and then.
+ * Instead it retires the node with the epoch it was retired in. Each thread
+ * announces the epoch it entered at while it reads, and the global epoch
+ * moves on only once every reading thread has seen the current one. Two
+ * epochs later no reader can still hold a node retired in the first, and it
+ * is freed.
+ *
+ * Entering and leaving an epoch are a store and a fence on the thread's
+ * own slot; only retiring, on the write path, ever updates shared state.
+ */
+
+#ifndef BTREE_EPOCH_H
+#define BTREE_EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * The one epoch domain of the process, shared by every tree, so a thread
+ * reading several trees announces itself once.
+ */
+class btree_epoch {
+    struct record;
+public:
+    /**
+     * Keeps the calling thread in an epoch while it lives, so no node it
+     * can reach is freed. Guards nest, only the outermost announces.
+     */
+    class guard {
+    public:
+        guard() : _rec(local()) {
+            if (_rec->_depth++ == 0)
+                instance().enter(_rec);
+        }
+        ~guard() {
+            if (--_rec->_depth == 0)
+                _rec->_epoch.store(0, std::memory_order_release);
+        }
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+
+    private:
+        record *_rec;
+    };
+
+    /**
+     * Frees p with deleter once no thread can still be reading it.
+     */
+    static void retire(void *p, void (*deleter)(void*)) {
+        auto rec = local();
+        // Whoever reads an epoch past this one came after p was taken out
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        rec->_retired.push_back({p, deleter, instance()._epoch.load(std::memory_order_relaxed)});
+        rec->_pending.store(rec->_retired.size(), std::memory_order_relaxed);
+        if (rec->_retired.size() % kBatch == 0)
+            instance().collect(rec);
+    }
+    template <typename U>
+    static void retire(U *p) {
+        retire(p, [](void *q) { delete static_cast<U*>(q); });
+    }
+
+    /**
+     * How many retired objects are waiting to be freed, over all threads.
+     */
+    static size_t pending() {
+        auto &self = instance();
+        size_t res = 0;
+        for (auto rec = self._records.load(std::memory_order_acquire); rec; rec = rec->_next)
+            res += rec->_pending.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> guard(self._orphans_lock);
+        return res + self._orphans.size();
+    }
+
+    /**
+     * Moves the epoch on twice, freeing everything this thread and the
+     * exited threads retired before the call, provided no thread is in an
+     * epoch, as once the threads that used a tree are done with it.
+     */
+    static void flush() {
+        auto rec = local();
+        instance().collect(rec);
+        instance().collect(rec);
+    }
+
+private:
+    // Retired objects a thread gathers before it tries to free some
+    static constexpr size_t kBatch = 64;
+
+    struct retired {
+        void *_p;
+        void (*_deleter)(void*);
+        uint64_t _epoch;
+    };
+    /**
+     * A thread's slot, reused by a later thread once it exits. _epoch is
+     * twice the epoch announced plus one while the thread reads, else 0.
+     * The rest belongs to the thread holding the record.
+     */
+    struct record {
+        std::atomic<uint64_t> _epoch{0};
+        std::atomic<bool> _in_use{true};
+        std::atomic<size_t> _pending{0};
+        unsigned _depth = 0;
+        std::vector<retired> _retired;
+        record *_next = nullptr;
+        // Keeps the next record's _epoch off this one's cache line
+        char _pad[64];
+    };
+    /**
+     * Takes a record for its thread, and hands the objects the thread still
+     * has retired over to the domain as it exits.
+     */
+    struct holder {
+        holder() : _rec(instance().acquire()) {};
+        ~holder() {
+            instance().release(_rec);
+        }
+        record *_rec;
+    };
+
+    btree_epoch() : _epoch(1), _records(nullptr) {};
+    // Only at exit, when no thread reads any more
+    ~btree_epoch() {
+        reclaim(_orphans, UINT64_MAX);
+        for (auto rec = _records.load(); rec;) {
+            auto next = rec->_next;
+            reclaim(rec->_retired, UINT64_MAX);
+            delete rec;
+            rec = next;
+        }
+    }
+
+    static btree_epoch& instance() {
+        static btree_epoch domain;
+        return domain;
+    }
+    static record* local() {
+        static thread_local holder h;
+        return h._rec;
+    }
+
+    void enter(record *rec) {
+        rec->_epoch.store(_epoch.load(std::memory_order_relaxed) * 2 + 1, std::memory_order_relaxed);
+        // The announcement is seen before anything the thread goes on to read
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    record* acquire() {
+        for (auto rec = _records.load(std::memory_order_acquire); rec; rec = rec->_next) {
+            bool free = false;
+            if (rec->_in_use.compare_exchange_strong(free, true))
+                return rec;
+        }
+        auto rec = new record();
+        rec->_next = _records.load(std::memory_order_relaxed);
+        while (!_records.compare_exchange_weak(rec->_next, rec, std::memory_order_release))
+            ;
+        return rec;
+    }
+    void release(record *rec) {
+        collect(rec);
+        {
+            std::lock_guard<std::mutex> guard(_orphans_lock);
+            _orphans.insert(_orphans.end(), rec->_retired.begin(), rec->_retired.end());
+        }
+        rec->_retired.clear();
+        rec->_pending.store(0, std::memory_order_relaxed);
+        rec->_in_use.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Moves the global epoch on if every reading thread has seen it, then
+     * frees what rec, and the exited threads, retired two epochs ago.
+     */
+    void collect(record *rec) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto epoch = _epoch.load(std::memory_order_relaxed);
+        bool behind = false;
+        for (auto r = _records.load(std::memory_order_acquire); r && !behind; r = r->_next) {
+            auto announced = r->_epoch.load(std::memory_order_acquire);
+            behind = (announced & 1) && announced / 2 != epoch;
+        }
+        if (!behind && _epoch.compare_exchange_strong(epoch, epoch + 1))
+            ++epoch;
+        reclaim(rec->_retired, epoch);
+        rec->_pending.store(rec->_retired.size(), std::memory_order_relaxed);
+        std::unique_lock<std::mutex> guard(_orphans_lock, std::try_to_lock);
+        if (guard)
+            reclaim(_orphans, epoch);
+    }
+    /**
+     * Frees the objects in list retired before epoch - 1.
+     */
+    static void reclaim(std::vector<retired> &list, uint64_t epoch) {
+        size_t kept = 0;
+        for (auto &r : list) {
+            if (r._epoch + 2 <= epoch)
+                r._deleter(r._p);
+            else
+                list[kept++] = r;
+        }
+        list.resize(kept);
+    }
+
+    std::atomic<uint64_t> _epoch;
+    std::atomic<record*> _records;
+    std::mutex _orphans_lock;
+    std::vector<retired> _orphans;
+};
+
+#endif
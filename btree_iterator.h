@@ -1,14 +1,17 @@
 #ifndef BTREE_ITERATOR_H
 #define BTREE_ITERATOR_H
 
+#include <algorithm>
 #include <iterator>
 #include <memory>
+#include <type_traits>
 #include <vector>
 /**
  * You MUST implement the btree iterators as (an) external class(es) in this file.
  * Failure to do so will result in a total mark of 0 for this deliverable.
  **/
-template <typename T> class btree;
+#include <cstddef>
+template <typename T, std::size_t N, bool Linked, typename Compare, typename Mapped> class btree;
 // iterator related interface stuff here; would be nice if you called your
 // iterator class btree_iterator (and possibly const_btree_iterator)
 template <typename T>
@@ -16,39 +19,125 @@ struct Identity {
     using type = T;
 };
 
-template <typename Base, template <typename U> class Constness> class btree_iterator;
+template <typename Tree, template <typename U> class Constness> class btree_iterator;
 
-template <typename Base, template <typename U> class Constness = Identity> class btree_iterator {
+/**
+ * The child indices taken on the way down from the root to a node, the
+ * last one in the low bits, so an iterator coming back up needs no search.
+ * An index takes only the bits needed for the node size, which all nodes
+ * of a tree share: nodes are at least half full, so the 128 bits hold the
+ * height of any tree of fewer than 2^63 elements. Should a path ever be
+ * longer, the oldest indices are shifted out, and nodes above them are
+ * found in their parents by pointer instead.
+ */
+class btree_path {
+public:
+    btree_path() : _indices(0), _depth(0) {}
+    // Records that the child at idx of a node of nodeSize values was taken
+    void push(std::size_t idx, std::size_t nodeSize) {
+        auto bits = width(nodeSize);
+        _indices = (_indices << bits) | idx;
+        if (_depth < kBits / bits)
+            ++_depth;
+    }
+    // Takes off the last index recorded into idx, false if there is none
+    bool pop(std::size_t nodeSize, std::size_t& idx) {
+        if (_depth == 0)
+            return false;
+        auto bits = width(nodeSize);
+        idx = static_cast<std::size_t>(_indices & ((word(1) << bits) - 1));
+        _indices >>= bits;
+        --_depth;
+        return true;
+    }
+private:
+    __extension__ typedef unsigned __int128 word;
+    static constexpr unsigned kBits = 128;
+    // Bits for the child indices 0 to nodeSize
+    static unsigned width(std::size_t nodeSize) {
+        return 64 - __builtin_clzll(nodeSize);
+    }
+    word _indices;
+    unsigned _depth;
+};
+
+/**
+ * How an iterator reads the element at its position. A set's element is the
+ * value in the node. A map keeps its keys and mapped values in separate
+ * arrays, so its element is a pair of references into the two, and ->
+ * hands back a holder of that pair to reach through.
+ */
+template <typename Tree, template <typename U> class Constness, typename Mapped = typename Tree::mapped_type>
+struct btree_element {
+    using value_type = typename Tree::value_type;
+    using reference = std::pair<const typename Tree::key_type&, typename Constness<Mapped>::type&>;
+    struct pointer {
+        reference ref;
+        const reference* operator->() const { return &ref; }
+    };
+    template <typename Location, typename Node>
+    static reference get(Location loc, Node* node) {
+        return reference(*loc, node->_mapped[loc - node->_childVals.begin()]);
+    }
+    static pointer address(reference ref) {
+        return pointer{ref};
+    }
+};
+template <typename Tree, template <typename U> class Constness>
+struct btree_element<Tree, Constness, void> {
+    using value_type = typename Constness<typename Tree::value_type>::type;
+    using reference = value_type&;
+    using pointer = value_type*;
+    template <typename Location, typename Node>
+    static reference get(Location loc, Node*) {
+        return *loc;
+    }
+    static pointer address(reference ref) {
+        return &ref;
+    }
+};
+
+// Tree is the btree being iterated over, btree<T>, btree<T, N> or a linked_btree
+template <typename Tree, template <typename U> class Constness = Identity> class btree_iterator {
+    using   Base              = typename Tree::value_type;
     using   T                 = typename Constness<Base>::type;
+    using   Element           = btree_element<Tree, Constness>;
+    friend Tree;
+    template <typename, template <typename U> class> friend class btree_iterator;
 public:
     using   difference_type   = std::ptrdiff_t;
     using   iterator_category = std::bidirectional_iterator_tag;
-    using   value_type        = T;
-    using   pointer           = T*;
-    using   reference         = T&;
+    using   value_type        = typename Element::value_type;
+    using   pointer           = typename Element::pointer;
+    using   reference         = typename Element::reference;
 
-    using   tree_node         = typename btree<Base>::bnode;
-    using   location          = typename std::vector<Base>::iterator;
-    // Iterator constructor
-    btree_iterator(location currNode, std::shared_ptr<tree_node> currTree, bool end = false) :
-    _currNode(currNode), _currTree(currTree), _end(end) {}
+    using   tree_node         = typename Tree::bnode;
+    using   location          = typename Tree::value_vector::iterator;
+    // Iterator constructor, past-the-end is one past the last leaf's values
+    btree_iterator(location currNode, tree_node* currTree) :
+    _currNode(currNode), _currTree(currTree), _path() {}
+    // As above, for a node reached from the root by path
+    btree_iterator(location currNode, tree_node* currTree, const btree_path& path) :
+    _currNode(currNode), _currTree(currTree), _path(path) {}
+    // An iterator converts to a const_iterator at the same position
+    template <template <typename U> class Other, typename = typename std::enable_if<
+        std::is_const<T>::value && !std::is_const<typename Other<Base>::type>::value>::type>
+    btree_iterator(const btree_iterator<Tree, Other>& other) :
+    _currNode(other._currNode), _currTree(other._currTree), _path(other._path) {}
     // Comparison operators
     bool operator==(const btree_iterator& other) const {
-        auto currTree = _currTree.lock();
-        auto otherTree = other._currTree.lock();
         return (_currNode == other._currNode &&
-                currTree == otherTree &&
-                _end == other._end);
+                _currTree == other._currTree);
     };
     bool operator!=(const btree_iterator& other) const {
         return !operator==(other);
     }
     // Access operators
     reference operator*() const {
-        return (*_currNode);
+        return Element::get(_currNode, _currTree);
     };
     pointer operator->() const {
-        return &(operator*());
+        return Element::address(operator*());
     }
     // Movement
     btree_iterator operator++(int) {
@@ -58,44 +147,44 @@ public:
     }
 
     btree_iterator& operator++() {
-        auto currTree = _currTree.lock();
-        auto curr_val = *_currNode;
-        auto dist = std::distance(currTree->_childVals.begin(), _currNode);
-        // check next sub_tree;
-        // next_tree is a shared ptr
-        auto &next_tree = currTree->_childTrees[dist + 1];
-        if(next_tree) {
-            // find min here
-            auto pair = findMin(next_tree);
-            auto dist = pair.first;
-            auto tree = pair.second;
-            auto vec_it = tree->_childVals.begin() + dist;
-            *this = btree_iterator(vec_it, tree);
+        if (Tree::linked) {
+            // every element is in a leaf, past the last one is the next leaf
+            auto next_leaf = _currTree->next_leaf();
+            if (++_currNode == _currTree->_childVals.end() && next_leaf) {
+                _currTree = next_leaf;
+                _currNode = next_leaf->_childVals.begin();
+                __builtin_prefetch(next_leaf->next_leaf());
+            }
+            return *this;
+        }
+        auto dist = std::distance(_currTree->_childVals.begin(), _currNode);
+        if (!_currTree->_leaf) {
+            // smallest element of the subtree after this one
+            descend(dist + 1);
+            while (!_currTree->_leaf)
+                descend(0);
+            _currNode = _currTree->_childVals.begin();
         }
         // go to next item in current subtree
         // if not at the end, return that one
-        else if((++_currNode) != currTree->_childVals.end()){
+        else if((++_currNode) != _currTree->_childVals.end()){
             // do nothing
         }
         else {
-            // at the end of local iterator,
-            // go up till you find one that is not at yet at the end
-            while(std::distance(_currNode, currTree->_childVals.end()) == 0) {
-                auto parent_tree = currTree->_parent.lock();
-                if (!parent_tree) {
-                    auto pair = findMax(currTree);
-                    auto dist = pair.first;
-                    auto tree = pair.second;
-                    auto vec_it = tree->_childVals.begin() + dist;
-                    *this = btree_iterator(vec_it, tree, true);
-                    break;
+            // at the end of a leaf, go up till we come from a subtree that
+            // has a separator after it. Only the last leaf has none, and
+            // its end is past-the-end, so then we stay where we are
+            auto path = _path;
+            for (auto tree = _currTree; tree->_parent; tree = tree->_parent) {
+                // the separator after us in the parent sits at our child index
+                auto child_idx = ascend(tree);
+                if (child_idx < tree->_parent->_childVals.size()) {
+                    _currTree = tree->_parent;
+                    _currNode = _currTree->_childVals.begin() + child_idx;
+                    return *this;
                 }
-                auto &p_vals = parent_tree->_childVals;
-                auto lower_bound = std::lower_bound(p_vals.begin(), p_vals.end(), curr_val);
-                _currNode = lower_bound;
-                _currTree = parent_tree;
-                currTree = _currTree.lock();
             }
+            _path = path;
         }
         return *this;
     };
@@ -106,57 +195,73 @@ public:
         return old_val;
     }
     btree_iterator& operator--() {
-        if (_end) {
-            _end = false;
+        if (Tree::linked) {
+            auto prev_leaf = _currTree->prev_leaf();
+            if (_currNode != _currTree->_childVals.begin()) {
+                --_currNode;
+            } else if (prev_leaf) {
+                _currTree = prev_leaf;
+                _currNode = prev_leaf->_childVals.end() - 1;
+            }
             return *this;
         }
-        // check previous sub_tree;
-        // prev_tree is a shared ptr
-        auto currTree = _currTree.lock();
-        auto curr_val = *_currNode;
-        auto dist = std::distance(currTree->_childVals.begin(), _currNode);
-        auto &prev_tree = currTree->_childTrees[dist];
-        if (prev_tree) {
-            // get last iterator from that tree
-            auto pair = findMax(prev_tree);
-            auto dist = pair.first;
-            auto tree = pair.second;
-            auto vec_it = tree->_childVals.begin() + dist;
-            *this = btree_iterator(vec_it, tree, true);
-            _end  = false;
+        auto dist = std::distance(_currTree->_childVals.begin(), _currNode);
+        if (!_currTree->_leaf) {
+            // largest element of the subtree before this one
+            descend(dist);
+            while (!_currTree->_leaf)
+                descend(_currTree->_childVals.size());
+            _currNode = _currTree->_childVals.end() - 1;
         }
-        else if(_currNode != currTree->_childVals.begin()){
+        else if(_currNode != _currTree->_childVals.begin()){
             --_currNode;
         }
         else {
-            // at the start of local iterator,
-            // go up till you find one that is not at yet at the start
-            while(std::distance(currTree->_childVals.begin(), _currNode) == 0) {
-                auto parent_tree = currTree->_parent.lock() ;
-                if (!parent_tree) {
-                    auto pair = findMin(currTree);
-                    auto dist = pair.first;
-                    auto tree = pair.second;
-                    auto vec_it = tree->_childVals.begin() + dist;
-                    *this = btree_iterator(vec_it, tree, true);
-                    break;
+            // at the start of a leaf, go up till we come from a subtree that
+            // has a separator before it. There is none before begin()
+            auto path = _path;
+            for (auto tree = _currTree; tree->_parent; tree = tree->_parent) {
+                auto child_idx = ascend(tree);
+                if (child_idx > 0) {
+                    _currTree = tree->_parent;
+                    _currNode = _currTree->_childVals.begin() + child_idx - 1;
+                    return *this;
                 }
-                auto &p_vals = parent_tree->_childVals;
-                auto lower_bound = std::lower_bound(p_vals.begin(), p_vals.end(), curr_val);
-                _currNode = lower_bound;
-                _currTree = parent_tree;
-                currTree = _currTree.lock();
             }
-            --_currNode;
+            _path = path;
         }
         return *this;
     };
 private:
+    /**
+     * Moves to the subtree at idx of the current node, remembering idx so
+     * coming back up needs no search.
+     */
+    void descend(size_t idx) {
+        _path.push(idx, _currTree->_size);
+        _currTree = _currTree->children()[idx];
+    }
+    /**
+     * The index of tree among its parent's subtrees, taken off the path.
+     * Iterators from find, lower_bound, upper_bound and select carry the
+     * path of their descent; those from begin(), end() and insert start
+     * with none, and a node not on the path is found in its parent by
+     * pointer instead.
+     */
+    size_t ascend(tree_node* tree) {
+        size_t idx;
+        if (_path.pop(tree->_size, idx))
+            return idx;
+        auto &p_trees = tree->_parent->children();
+        return std::distance(p_trees.begin(), std::find(p_trees.begin(), p_trees.end(), tree));
+    }
+
     // Iterator stores current subtree
     // and current location in subtree
     location _currNode;
-    std::weak_ptr<tree_node> _currTree;
-    bool _end;
+    tree_node* _currTree;
+    // Child indices taken on the way down to the current node
+    btree_path _path;
 };
 
 #endif
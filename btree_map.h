@@ -0,0 +1,188 @@
+/**
+ * An ordered map on the btree's nodes. Each node keeps its keys in one array
+ * and their mapped values in another beside it, so a search reads only keys;
+ * the mapped value is touched once the key is found. Iterators are those of
+ * the btree and read an element as a std::pair of references to its key and
+ * mapped value.
+ */
+
+#ifndef BTREE_MAP_H
+#define BTREE_MAP_H
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+#include "btree.h"
+
+/**
+ * btree_map<K, V> maps unique keys K, ordered by Compare, to values V. As
+ * with btree, N fixes the node capacity at compile time and Linked keeps the
+ * mapped values in the leaves of a B+tree, whose internal nodes then hold
+ * keys alone.
+ */
+template <typename K, typename V, size_t N = 0, bool Linked = false, typename Compare = std::less<K>>
+class btree_map : private btree<K, N, Linked, Compare, V> {
+    using base = btree<K, N, Linked, Compare, V>;
+public:
+    using typename base::key_type;
+    using typename base::mapped_type;
+    using typename base::value_type;
+    using typename base::key_compare;
+    using typename base::iterator;
+    using typename base::const_iterator;
+    using typename base::reverse_iterator;
+    using typename base::const_reverse_iterator;
+    using base::linked;
+
+    /**
+     * Constructs an empty map, see the btree constructor.
+     */
+    btree_map(size_t maxNodeElems = N ? N : 40, const Compare& comp = Compare()) : base(maxNodeElems, comp) {};
+
+    using base::begin;
+    using base::end;
+    using base::cbegin;
+    using base::cend;
+    using base::rbegin;
+    using base::rend;
+    using base::size;
+    using base::rank;
+    using base::lower_bound;
+    using base::upper_bound;
+    using base::equal_range;
+    using base::key_comp;
+    using base::slab_usage;
+
+    // Forwarded rather than brought in with using, which would also bring
+    // in btree's internal overloads of the same names
+    iterator find(const K& key) {
+        return base::find(key);
+    }
+    const_iterator find(const K& key) const {
+        return base::find(key);
+    }
+    template <typename Q, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const Q& key) {
+        return base::find(key);
+    }
+    template <typename Q, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator find(const Q& key) const {
+        return base::find(key);
+    }
+    iterator select(size_t idx) {
+        return base::select(idx);
+    }
+    const_iterator select(size_t idx) const {
+        return base::select(idx);
+    }
+
+    /**
+     * Removes key and the value it maps to, if key is mapped.
+     *
+     * @return the number of keys removed, 0 or 1.
+     */
+    size_t erase(const K& key) {
+        return base::erase(key);
+    }
+    /**
+     * Removes the key and value the iterator is positioned at.
+     *
+     * @return an iterator to the key that followed it, or end().
+     */
+    iterator erase(iterator pos) {
+        return base::erase(pos);
+    }
+
+    /**
+     * Maps key to a value built from args, unless key is already mapped,
+     * in which case nothing is built. Descends the tree once.
+     *
+     * @param key the key to map.
+     * @param args the arguments to construct the mapped value from.
+     * @return a pair whose first field is an iterator positioned at key,
+     *                 and whose second field is true if it was inserted.
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+        return this->insert_unique(key, [&key] () -> const K& { return key; },
+                                   [&args...] () { return V(std::forward<Args>(args)...); });
+    }
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+        return this->insert_unique(key, [&key] () -> K&& { return std::move(key); },
+                                   [&args...] () { return V(std::forward<Args>(args)...); });
+    }
+
+    /**
+     * Inserts a key and its mapped value, unless the key is already
+     * mapped, in which case the map is left as it was.
+     *
+     * @param kv the key and mapped value.
+     * @return as for try_emplace.
+     */
+    std::pair<iterator, bool> insert(const value_type& kv) {
+        return try_emplace(kv.first, kv.second);
+    }
+    std::pair<iterator, bool> insert(value_type&& kv) {
+        return try_emplace(kv.first, std::move(kv.second));
+    }
+
+    /**
+     * Maps key to obj, inserting it or overwriting the value it had,
+     * in a single descent of the tree.
+     *
+     * @param key the key to map.
+     * @param obj the value to map it to.
+     * @return a pair whose first field is an iterator positioned at key,
+     *                 and whose second field is true if it was inserted
+     *                 and false if its value was assigned.
+     */
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& obj) {
+        // obj is only used up by try_emplace if it inserts
+        auto res = try_emplace(key, std::forward<M>(obj));
+        if (!res.second)
+            res.first->second = std::forward<M>(obj);
+        return res;
+    }
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(K&& key, M&& obj) {
+        auto res = try_emplace(std::move(key), std::forward<M>(obj));
+        if (!res.second)
+            res.first->second = std::forward<M>(obj);
+        return res;
+    }
+
+    /**
+     * Returns the value key maps to, mapping it to a value-initialised V
+     * first if it was not mapped.
+     */
+    V& operator[](const K& key) {
+        return try_emplace(key).first->second;
+    }
+    V& operator[](K&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    /**
+     * Returns the value key maps to.
+     *
+     * @throw std::out_of_range if key is not mapped.
+     */
+    V& at(const K& key) {
+        auto iter = find(key);
+        if (iter == end())
+            throw std::out_of_range("btree_map::at");
+        return iter->second;
+    }
+    const V& at(const K& key) const {
+        auto iter = find(key);
+        if (iter == end())
+            throw std::out_of_range("btree_map::at");
+        return iter->second;
+    }
+};
+
+#endif
@@ -0,0 +1,135 @@
+/**
+ * The threads behind the btree's parallel bulk loading: a fork-join loop
+ * over a fixed number of tasks, and a parallel merge sort for input that
+ * is not sorted yet.
+ */
+
+#ifndef BTREE_PARALLEL_H
+#define BTREE_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs f(0) to f(tasks - 1), each on a thread of its own but the first,
+ * which runs on the calling thread, and returns once all are done.
+ */
+template <typename F>
+void btree_parallel_for(size_t tasks, F f) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < tasks; ++i)
+        workers.emplace_back(f, i);
+    if (tasks > 0)
+        f(0);
+    for (auto &worker : workers)
+        worker.join();
+}
+
+/**
+ * The number of elements of a that come before the d-th element of the
+ * merge of a and b, with a's first among equal elements as std::merge has
+ * them.
+ */
+template <typename It, typename Compare>
+size_t btree_merge_split(It a, size_t a_len, It b, size_t b_len, size_t d, const Compare& comp) {
+    size_t lo = d > b_len ? d - b_len : 0;
+    size_t hi = std::min(d, a_len);
+    while (lo < hi) {
+        auto i = lo + (hi - lo) / 2;
+        if (!comp(b[d - i - 1], a[i]))
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+/**
+ * One round of a merge sort: merges each pair of adjacent runs of src,
+ * runs[i] to runs[i + 1], into the same places in dst, moving a run
+ * without a partner across as it is. Each thread writes an equal share of
+ * dst, whichever runs that falls in, so a round with few long runs keeps
+ * every thread busy. The shares are all cut before any thread starts
+ * moving elements out of src. Returns the runs left.
+ */
+template <typename Src, typename Dst, typename Compare>
+std::vector<size_t> btree_merge_round(Src src, Dst dst, const std::vector<size_t>& runs,
+                                      unsigned threads, const Compare& comp) {
+    auto n = runs.back();
+    auto share = [n, threads] (size_t t) { return n * t / threads; };
+    // The pair of runs at out: its start, and where the second run starts and ends
+    auto pair_at = [&runs] (size_t out, size_t &mid, size_t &end) {
+        size_t r = std::upper_bound(runs.begin(), runs.end(), out) - runs.begin() - 1;
+        r -= r % 2;
+        mid = runs[r + 1];
+        end = r + 2 < runs.size() ? runs[r + 2] : mid;
+        return runs[r];
+    };
+    // cuts[t] is how much of the first run of its pair goes before share(t)
+    std::vector<size_t> cuts(threads + 1, 0);
+    btree_parallel_for(threads, [&] (size_t t) {
+        size_t mid, end;
+        auto begin = pair_at(share(t), mid, end);
+        cuts[t] = btree_merge_split(src + begin, mid - begin, src + mid, end - mid, share(t) - begin, comp);
+    });
+    btree_parallel_for(threads, [&] (size_t t) {
+        auto out_lo = share(t);
+        auto out_hi = share(t + 1);
+        while (out_lo < out_hi) {
+            size_t mid, end;
+            auto begin = pair_at(out_lo, mid, end);
+            auto hi = std::min(end, out_hi);
+            auto a_lo = out_lo > begin ? cuts[t] : 0;
+            auto a_hi = hi < end ? cuts[t + 1] : mid - begin;
+            std::merge(std::make_move_iterator(src + begin + a_lo), std::make_move_iterator(src + begin + a_hi),
+                       std::make_move_iterator(src + mid + (out_lo - begin - a_lo)),
+                       std::make_move_iterator(src + mid + (hi - begin - a_hi)),
+                       dst + out_lo, comp);
+            out_lo = hi;
+        }
+    });
+    std::vector<size_t> res;
+    for (size_t r = 0; r < runs.size(); r += 2)
+        res.push_back(runs[r]);
+    if (res.back() != n)
+        res.push_back(n);
+    return res;
+}
+
+/**
+ * Sorts [first, last) by comp on the given number of threads: each sorts
+ * a slice with std::sort, then rounds of merges through a buffer halve the
+ * number of sorted runs until one is left.
+ */
+template <typename RandomIt, typename Compare>
+void btree_parallel_sort(RandomIt first, RandomIt last, unsigned threads, const Compare& comp) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    size_t n = last - first;
+    threads = std::max(1u, std::min<unsigned>(threads, n / 1024));
+    std::vector<size_t> runs;
+    for (size_t t = 0; t <= threads; ++t)
+        runs.push_back(n * t / threads);
+    btree_parallel_for(threads, [&] (size_t t) {
+        std::sort(first + runs[t], first + runs[t + 1], comp);
+    });
+    if (threads == 1)
+        return;
+    std::vector<value_type> buffer(n);
+    bool in_buffer = false;
+    while (runs.size() > 2) {
+        runs = in_buffer ? btree_merge_round(buffer.begin(), first, runs, threads, comp)
+                         : btree_merge_round(first, buffer.begin(), runs, threads, comp);
+        in_buffer = !in_buffer;
+    }
+    if (in_buffer) {
+        btree_parallel_for(threads, [&] (size_t t) {
+            std::move(buffer.begin() + n * t / threads, buffer.begin() + n * (t + 1) / threads,
+                      first + n * t / threads);
+        });
+    }
+}
+
+#endif
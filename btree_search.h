@@ -0,0 +1,278 @@
+/**
+ * Intra-node search for the btree. Given a node's sorted values, finds the
+ * index of the first one not less than an element, as std::lower_bound does.
+ *
+ * Arithmetic keys are compared a whole SSE2 (or AVX2, when the compiler
+ * targets it) register at a time, the answer being read off the comparison
+ * mask; no branch depends on the data until the matching block is found.
+ * That only pays with at least four keys to a register: 32-bit keys under
+ * SSE2, and 64-bit ones under AVX2. Two to a register, 64-bit keys were no
+ * faster than bisection at 40 values a node and slower beyond, so without
+ * AVX2 they use the scalar search, as do other types and targets without
+ * vector instructions.
+ *
+ * Lookups also need to know whether the value found equals the element.
+ * Keys with a three-way comparison, such as strings, learn that during the
+ * search itself; the rest compare the value found once more. Both shortcuts
+ * are taken only for keys in their natural order, a tree with its own
+ * Compare searches through it.
+ */
+
+#ifndef BTREE_SEARCH_H
+#define BTREE_SEARCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * The scalar search, for keys with no vector comparison. Large nodes are
+ * narrowed by bisection, the last few values are scanned.
+ */
+template <typename T, typename Enable = void>
+struct btree_simd_search {
+    static size_t search(const T* vals, size_t n, const T& elem) {
+        size_t lo = 0;
+        while (n > 8) {
+            auto half = n / 2;
+            if (vals[lo + half] < elem) {
+                lo += half + 1;
+                n -= half + 1;
+            } else {
+                n = half;
+            }
+        }
+        while (n > 0 && vals[lo] < elem) {
+            ++lo;
+            --n;
+        }
+        return lo;
+    }
+};
+
+#if defined(__SSE2__)
+/**
+ * Shared by the vector searches. Block is a traits class giving the number
+ * of keys per register, Width, and less(vals, key), the mask with bit i set
+ * when vals[i] < elem; key is the element broadcast by Block::key(elem).
+ * Bisects down to a window of two cache lines, then scans it a register at
+ * a time. The values are sorted, so the set bits of a mask are always its
+ * low ones and the first mask that is not full locates the answer.
+ */
+template <typename T, typename Block>
+size_t btree_block_search(const T* vals, size_t n, const T& elem) {
+    constexpr size_t kWidth = Block::Width;
+    constexpr unsigned kFull = (1u << kWidth) - 1;
+    constexpr size_t kWindow = 128 / sizeof(T);
+    size_t lo = 0;
+    while (n > kWindow) {
+        auto half = n / 2;
+        if (vals[lo + half] < elem) {
+            lo += half + 1;
+            n -= half + 1;
+        } else {
+            n = half;
+        }
+    }
+    auto key = Block::key(elem);
+    auto end = lo + n;
+    for (; lo + kWidth <= end; lo += kWidth) {
+        unsigned mask = Block::less(vals + lo, key);
+        if (mask != kFull)
+            return lo + __builtin_ctz(~mask);
+    }
+    while (lo < end && vals[lo] < elem)
+        ++lo;
+    return lo;
+}
+
+#if defined(__AVX2__)
+template <typename T>
+struct btree_int32_block {
+    static constexpr size_t Width = 8;
+    // Unsigned keys are compared signed after flipping their top bits
+    static __m256i bias() {
+        return _mm256_set1_epi32(std::is_signed<T>::value ? 0 : INT32_MIN);
+    }
+    static __m256i key(const T& elem) {
+        return _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(elem)), bias());
+    }
+    static unsigned less(const T* vals, __m256i key) {
+        auto v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(vals)), bias());
+        return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(key, v)));
+    }
+};
+template <typename T>
+struct btree_int64_block {
+    static constexpr size_t Width = 4;
+    static __m256i bias() {
+        return _mm256_set1_epi64x(std::is_signed<T>::value ? 0 : INT64_MIN);
+    }
+    static __m256i key(const T& elem) {
+        return _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(elem)), bias());
+    }
+    static unsigned less(const T* vals, __m256i key) {
+        auto v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(vals)), bias());
+        return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(key, v)));
+    }
+};
+struct btree_float_block {
+    static constexpr size_t Width = 8;
+    static __m256 key(float elem) { return _mm256_set1_ps(elem); }
+    static unsigned less(const float* vals, __m256 key) {
+        return _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(vals), key, _CMP_LT_OQ));
+    }
+};
+struct btree_double_block {
+    static constexpr size_t Width = 4;
+    static __m256d key(double elem) { return _mm256_set1_pd(elem); }
+    static unsigned less(const double* vals, __m256d key) {
+        return _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(vals), key, _CMP_LT_OQ));
+    }
+};
+#else
+template <typename T>
+struct btree_int32_block {
+    static constexpr size_t Width = 4;
+    // Unsigned keys are compared signed after flipping their top bits
+    static __m128i bias() {
+        return _mm_set1_epi32(std::is_signed<T>::value ? 0 : INT32_MIN);
+    }
+    static __m128i key(const T& elem) {
+        return _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(elem)), bias());
+    }
+    static unsigned less(const T* vals, __m128i key) {
+        auto v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(vals)), bias());
+        return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(key, v)));
+    }
+};
+struct btree_float_block {
+    static constexpr size_t Width = 4;
+    static __m128 key(float elem) { return _mm_set1_ps(elem); }
+    static unsigned less(const float* vals, __m128 key) {
+        return _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(vals), key));
+    }
+};
+#endif
+
+template <typename T>
+struct btree_simd_search<T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 4>::type> {
+    static size_t search(const T* vals, size_t n, const T& elem) {
+        return btree_block_search<T, btree_int32_block<T>>(vals, n, elem);
+    }
+};
+template <>
+struct btree_simd_search<float> {
+    static size_t search(const float* vals, size_t n, const float& elem) {
+        return btree_block_search<float, btree_float_block>(vals, n, elem);
+    }
+};
+#if defined(__AVX2__)
+template <typename T>
+struct btree_simd_search<T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 8>::type> {
+    static size_t search(const T* vals, size_t n, const T& elem) {
+        return btree_block_search<T, btree_int64_block<T>>(vals, n, elem);
+    }
+};
+template <>
+struct btree_simd_search<double> {
+    static size_t search(const double* vals, size_t n, const double& elem) {
+        return btree_block_search<double, btree_double_block>(vals, n, elem);
+    }
+};
+#endif
+#endif
+
+/**
+ * Three-way comparison of keys, the sign of compare(a, b) telling whether a
+ * is less than, equal to or greater than b. Strings have it through
+ * compare(). Another key type gets it from a specialisation defining value
+ * as true and a compare function, which should take one pass over the keys
+ * where operator< and operator== would take one each.
+ */
+template <typename T>
+struct btree_three_way {
+    static constexpr bool value = false;
+};
+template <typename C, typename Traits, typename Alloc>
+struct btree_three_way<std::basic_string<C, Traits, Alloc>> {
+    static constexpr bool value = true;
+    static int compare(const std::basic_string<C, Traits, Alloc>& a,
+                       const std::basic_string<C, Traits, Alloc>& b) {
+        return a.compare(b);
+    }
+};
+
+/**
+ * Whether Compare orders a K against the values just as T's operator< does,
+ * which is all the vector and three-way searches know how to do. Any other
+ * ordering, or a key of another type, is searched through Compare itself.
+ */
+template <typename T, typename K, typename Compare>
+struct btree_natural_order : std::integral_constant<bool, std::is_same<T, K>::value &&
+    (std::is_same<Compare, std::less<T>>::value || std::is_same<Compare, std::less<>>::value)> {};
+
+/**
+ * Finds the index of the first of n sorted values not less than elem under
+ * comp. Arithmetic types in their natural order get btree_simd_search
+ * above, vector or scalar, anything else std::lower_bound.
+ */
+template <typename T, typename K, typename Compare>
+size_t btree_search(const T* vals, size_t n, const K& elem, const Compare&, std::true_type) {
+    return btree_simd_search<T>::search(vals, n, elem);
+}
+template <typename T, typename K, typename Compare>
+size_t btree_search(const T* vals, size_t n, const K& elem, const Compare& comp, std::false_type) {
+    return std::lower_bound(vals, vals + n, elem, comp) - vals;
+}
+template <typename T, typename K, typename Compare>
+size_t btree_search(const T* vals, size_t n, const K& elem, const Compare& comp) {
+    return btree_search(vals, n, elem, comp, std::integral_constant<bool,
+        std::is_arithmetic<T>::value && btree_natural_order<T, K, Compare>::value>());
+}
+
+/**
+ * As btree_search, also setting found if the value at the index returned
+ * is equivalent to elem. With a three-way comparison each probe of the
+ * bisection compares once and a match ends it early; otherwise the value
+ * found is compared with elem once more.
+ */
+template <typename T, typename K, typename Compare>
+size_t btree_search(const T* vals, size_t n, const K& elem, const Compare&, bool& found, std::true_type) {
+    size_t lo = 0;
+    while (n > 0) {
+        auto half = n / 2;
+        auto cmp = btree_three_way<T>::compare(vals[lo + half], elem);
+        if (cmp == 0) {
+            found = true;
+            return lo + half;
+        }
+        if (cmp < 0) {
+            lo += half + 1;
+            n -= half + 1;
+        } else {
+            n = half;
+        }
+    }
+    found = false;
+    return lo;
+}
+template <typename T, typename K, typename Compare>
+size_t btree_search(const T* vals, size_t n, const K& elem, const Compare& comp, bool& found, std::false_type) {
+    auto idx = btree_search(vals, n, elem, comp);
+    found = idx < n && !comp(elem, vals[idx]);
+    return idx;
+}
+template <typename T, typename K, typename Compare>
+size_t btree_search(const T* vals, size_t n, const K& elem, const Compare& comp, bool& found) {
+    return btree_search(vals, n, elem, comp, found, std::integral_constant<bool,
+        btree_three_way<T>::value && btree_natural_order<T, K, Compare>::value>());
+}
+
+#endif
@@ -0,0 +1,698 @@
+/**
+ * A B+tree that many threads may read and write at once, by optimistic
+ * lock coupling. Every node carries a version; a writer locks a node by
+ * setting a bit in it and bumps the version as it unlocks. Readers take no
+ * locks at all: they note each node's version, read it, and check the
+ * version is unchanged before trusting what they read, starting over if a
+ * writer got in the way. A writer descends the same way and locks only the
+ * nodes it is about to change, a leaf and, when it splits, its parent.
+ */
+
+#ifndef CONCURRENT_BTREE_H
+#define CONCURRENT_BTREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <type_traits>
+
+#include "btree_epoch.h"
+#include "btree_search.h"
+
+/**
+ * concurrent_btree<T, N> holds unique elements ordered by Compare in nodes
+ * of N elements, with every element in a leaf and copies of some in the
+ * internal nodes above to route searches.
+ *
+ * A reader may copy an element while a writer is moving it, and only later
+ * learn that it must discard the copy, so T has to be trivially copyable,
+ * which rules out std::string and any other key that owns memory.
+ * Such copies are made a word at a time with relaxed atomics, see node.
+ *
+ * Full nodes are split on the way down, so a split never has to climb back
+ * up the tree. An erase that empties a leaf takes it out of its parent,
+ * first refilling the internal nodes above it that are down to one
+ * separator, from a neighbour or by merging with it, so none is ever
+ * emptied; a root left with one subtree is replaced by it. Every leaf
+ * stays at the same depth and every internal node keeps two subtrees, so
+ * the height stays logarithmic in the number of leaves and shrinks as the
+ * tree empties. Leaves are not merged, so a tree emptied at random holds
+ * fewer elements per leaf than one built up. Nodes taken out are freed
+ * through btree_epoch once no reader can still be in them.
+ *
+ * Each call enters an epoch for its length; a thread making many calls in
+ * a row can hold a btree_epoch::guard around them all instead.
+ *
+ * Readers write nothing shared and so should scale with cores, but that is
+ * unmeasured: on the one-core machine test22 was run on, a mix of 95% finds
+ * ran at about 0.8 Mops/s here against about 1 Mops/s for a btree behind
+ * one mutex, at every thread count.
+ */
+template <typename T, size_t N = 32, typename Compare = std::less<T>>
+class concurrent_btree {
+    static_assert(N >= 3, "a node must be able to hold at least 3 elements to be split");
+    static_assert(std::is_trivially_copyable<T>::value, "readers may copy an element as it is written");
+public:
+    using key_compare = Compare;
+
+    /**
+     * Constructs an empty tree.
+     *
+     * @param comp the ordering of the elements.
+     */
+    concurrent_btree(const Compare& comp = Compare()) : _root(new node(true)), _size(0), _comp(comp) {};
+
+    // Threads share the one tree, they never copy it
+    concurrent_btree(const concurrent_btree&) = delete;
+    concurrent_btree& operator=(const concurrent_btree&) = delete;
+
+    /**
+     * Frees every node. No other thread may be using the tree.
+     */
+    ~concurrent_btree() {
+        destroy(_root.load());
+    }
+
+    /**
+     * The number of elements, which other threads may be changing.
+     */
+    size_t size() const {
+        return _size.load(std::memory_order_relaxed);
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /**
+     * Whether the tree holds an element equivalent to key. Takes no locks
+     * and writes nothing shared.
+     */
+    bool contains(const T& key) const {
+        btree_epoch::guard guard;
+        bool found;
+        while (!lookup(key, found))
+            std::this_thread::yield();
+        return found;
+    }
+    /**
+     * Copies the element equivalent to key into out, if there is one. The
+     * copy is checked against the leaf's version like any other read, so
+     * it is the element as it was at some moment it was in the tree.
+     *
+     * @return true if an element was found, else out is left as it was.
+     */
+    bool find(const T& key, T& out) const {
+        btree_epoch::guard guard;
+        bool found;
+        while (!lookup(key, found, &out))
+            std::this_thread::yield();
+        return found;
+    }
+
+    /**
+     * Inserts elem, unless an equivalent element is already there.
+     *
+     * @return true if elem was inserted.
+     */
+    bool insert(const T& elem) {
+        btree_epoch::guard guard;
+        attempt res;
+        while ((res = try_insert(elem)) == attempt::retry)
+            std::this_thread::yield();
+        return res == attempt::yes;
+    }
+
+    /**
+     * Erases the element equivalent to key, if there is one.
+     *
+     * @return true if an element was erased.
+     */
+    bool erase(const T& key) {
+        btree_epoch::guard guard;
+        attempt res;
+        while ((res = try_erase(key)) == attempt::retry)
+            std::this_thread::yield();
+        return res == attempt::yes;
+    }
+
+    key_compare key_comp() const {
+        return _comp;
+    }
+
+private:
+    // The values of a node are held in words of this type
+    using word = uint64_t;
+    static constexpr size_t kWords = (N * sizeof(T) + sizeof(word) - 1) / sizeof(word);
+
+    /**
+     * A leaf, and the first part of every internal node. Every field a
+     * reader looks at is atomic and accessed relaxed, the values included,
+     * which are kept as the bytes of a T[N] in atomic words. Versions order
+     * the rest as in a seqlock:
+     *
+     * - a writer locks the version, then fences (release) before it writes
+     *   anything, and unlocks with a release that bumps the version;
+     * - a reader reads the version (acquire), copies what it needs into
+     *   locals with load(), then fences (acquire) and reads the version
+     *   again, see validate. The copy is only used if the two match.
+     *
+     * A reader racing a writer may so copy a torn T, but never reads
+     * memory a writer is writing non-atomically, and throws the copy away.
+     */
+    class node {
+    public:
+        explicit node(bool leaf) : _version(0), _count(0), _leaf(leaf) {
+            for (auto &w : _words)
+                w.store(0, std::memory_order_relaxed);
+        }
+
+        // A reader reads no further than N values, whatever count it saw
+        size_t count() const {
+            return std::min<size_t>(_count.load(std::memory_order_relaxed), N);
+        }
+
+        /**
+         * Copies the first count values into vals.
+         */
+        void load(T* vals, size_t count) const {
+            word buf[kWords];
+            auto bytes = count * sizeof(T);
+            for (size_t i = 0; i * sizeof(word) < bytes; ++i)
+                buf[i] = _words[i].load(std::memory_order_relaxed);
+            std::memcpy(vals, buf, bytes);
+        }
+        /**
+         * Writes vals over the first count values. Only with the node
+         * locked, or not yet in the tree.
+         */
+        void store(const T* vals, size_t count) {
+            if (count == 0)
+                return;
+            word buf[kWords];
+            auto bytes = count * sizeof(T);
+            auto words = (bytes + sizeof(word) - 1) / sizeof(word);
+            // A word only partly covered keeps the bytes after the end
+            buf[words - 1] = _words[words - 1].load(std::memory_order_relaxed);
+            std::memcpy(buf, vals, bytes);
+            for (size_t i = 0; i < words; ++i)
+                _words[i].store(buf[i], std::memory_order_relaxed);
+        }
+
+        std::atomic<uint64_t> _version;
+        std::atomic<uint32_t> _count;
+        const bool _leaf;
+        std::atomic<word> _words[kWords];
+    };
+    /**
+     * An internal node, whose i-th subtree holds the elements after the
+     * (i - 1)-th value up to and including the i-th.
+     */
+    class inode : public node {
+    public:
+        inode() : node(false) {
+            for (auto &child : _children)
+                child.store(nullptr, std::memory_order_relaxed);
+        }
+
+        std::atomic<node*> _children[N + 1];
+    };
+
+    enum class attempt { retry, yes, no };
+
+    // The low bits of a version
+    static constexpr uint64_t kObsolete = 1;
+    static constexpr uint64_t kLocked = 2;
+
+    /**
+     * Notes the version of node in version, waiting for a writer holding it
+     * to be done. Returns false if the node has been taken out of the tree.
+     */
+    static bool read_lock(const node* n, uint64_t &version) {
+        version = n->_version.load(std::memory_order_acquire);
+        while (version & kLocked) {
+            std::this_thread::yield();
+            version = n->_version.load(std::memory_order_acquire);
+        }
+        return !(version & kObsolete);
+    }
+    /**
+     * Whether node is still at version, so what was read from it since
+     * read_lock holds.
+     */
+    static bool validate(const node* n, uint64_t version) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return n->_version.load(std::memory_order_relaxed) == version;
+    }
+    /**
+     * Locks node for writing, provided it is still at version, so what was
+     * read from it since read_lock holds too.
+     */
+    static bool upgrade(node* n, uint64_t version) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!n->_version.compare_exchange_strong(version, version + kLocked, std::memory_order_acquire))
+            return false;
+        // Readers who see any write that follows see the version locked
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+    static void unlock(node* n) {
+        n->_version.fetch_add(kLocked, std::memory_order_release);
+    }
+    static void unlock_obsolete(node* n) {
+        n->_version.fetch_add(kLocked + kObsolete, std::memory_order_release);
+    }
+
+    /**
+     * Copies the values of n into vals, returning how many, and searches
+     * them for key. Like anything read from n, the result holds only once
+     * n is validated.
+     */
+    size_t search(const node* n, T* vals, size_t &count, const T& key, bool &found) const {
+        count = n->count();
+        n->load(vals, count);
+        return btree_search(vals, count, key, _comp, found);
+    }
+    /**
+     * The subtree key belongs in, nullptr if a torn read found none.
+     */
+    node* child(const node* n, const T& key) const {
+        T vals[N];
+        auto count = n->count();
+        n->load(vals, count);
+        auto idx = btree_search(vals, count, key, _comp);
+        return static_cast<const inode*>(n)->_children[idx].load(std::memory_order_acquire);
+    }
+
+    /**
+     * Locks in a version of the root, false if the root was replaced first.
+     */
+    bool read_root(node* &n, uint64_t &version) const {
+        n = _root.load(std::memory_order_acquire);
+        return read_lock(n, version) && n == _root.load(std::memory_order_acquire);
+    }
+
+    /**
+     * One optimistic descent for contains and find, false if it has to
+     * start over. The element found is copied to out, if given, only once
+     * the leaf is validated.
+     */
+    bool lookup(const T& key, bool &found, T* out = nullptr) const {
+        node* n;
+        uint64_t version;
+        if (!read_root(n, version))
+            return false;
+        while (!n->_leaf) {
+            auto next = child(n, key);
+            uint64_t next_version;
+            // The parent is checked once the child is locked in, so a split
+            // of the child that moved key elsewhere is noticed
+            if (!next || !read_lock(next, next_version) || !validate(n, version))
+                return false;
+            n = next;
+            version = next_version;
+        }
+        T vals[N];
+        size_t count;
+        auto idx = search(n, vals, count, key, found);
+        if (!validate(n, version))
+            return false;
+        if (found && out)
+            *out = vals[idx];
+        return true;
+    }
+
+    attempt try_insert(const T& elem) {
+        node* n;
+        uint64_t version;
+        if (!read_root(n, version))
+            return attempt::retry;
+        inode* parent = nullptr;
+        uint64_t p_version = 0;
+        for (;;) {
+            if (n->_count.load(std::memory_order_relaxed) == N) {
+                if (parent && !upgrade(parent, p_version))
+                    return attempt::retry;
+                if (!upgrade(n, version)) {
+                    if (parent)
+                        unlock(parent);
+                    return attempt::retry;
+                }
+                if (!parent && n != _root.load(std::memory_order_relaxed)) {
+                    unlock(n);
+                    return attempt::retry;
+                }
+                split(parent, n);
+                unlock(n);
+                if (parent)
+                    unlock(parent);
+                return attempt::retry;
+            }
+            if (n->_leaf)
+                break;
+            auto next = child(n, elem);
+            uint64_t next_version;
+            if (!next || !read_lock(next, next_version) || !validate(n, version))
+                return attempt::retry;
+            parent = static_cast<inode*>(n);
+            p_version = version;
+            n = next;
+            version = next_version;
+        }
+        T vals[N];
+        size_t count;
+        bool found;
+        auto idx = search(n, vals, count, elem, found);
+        if (found)
+            return validate(n, version) ? attempt::no : attempt::retry;
+        // Succeeds only if the leaf is as it was searched, so vals is its
+        // values, fewer than N of them
+        if (!upgrade(n, version))
+            return attempt::retry;
+        std::copy_backward(vals + idx, vals + count, vals + count + 1);
+        vals[idx] = elem;
+        n->store(vals, count + 1);
+        n->_count.store(count + 1, std::memory_order_relaxed);
+        unlock(n);
+        _size.fetch_add(1, std::memory_order_relaxed);
+        return attempt::yes;
+    }
+
+    attempt try_erase(const T& key) {
+        // A refill goes straight back down, before another thread can undo it
+        for (;;) {
+            node* n;
+            uint64_t version;
+            if (!read_root(n, version))
+                return attempt::retry;
+            inode* parent = nullptr;
+            uint64_t p_version = 0;
+            // The highest of the internal nodes down to one separator just
+            // above where the descent is, and its parent
+            inode* thin = nullptr;
+            inode* t_parent = nullptr;
+            uint64_t t_version = 0;
+            uint64_t tp_version = 0;
+            while (!n->_leaf) {
+                auto next = child(n, key);
+                uint64_t next_version;
+                if (!next || !read_lock(next, next_version) || !validate(n, version))
+                    return attempt::retry;
+                if (!next->_leaf && next->count() > 1) {
+                    thin = nullptr;
+                } else if (!next->_leaf && !thin) {
+                    thin = static_cast<inode*>(next);
+                    t_parent = static_cast<inode*>(n);
+                    t_version = next_version;
+                    tp_version = version;
+                }
+                parent = static_cast<inode*>(n);
+                p_version = version;
+                n = next;
+                version = next_version;
+            }
+            T vals[N];
+            size_t count;
+            bool found;
+            auto idx = search(n, vals, count, key, found);
+            if (!found)
+                return validate(n, version) ? attempt::no : attempt::retry;
+            // The last element of a leaf takes the leaf with it, if it has a
+            // parent. A parent down to one separator is refilled first, from
+            // the top of the run of such nodes down, unless it is the root,
+            // which is then replaced by its other subtree
+            bool unlink = parent && count == 1;
+            if (unlink && thin) {
+                if (!refill(t_parent, tp_version, thin, t_version))
+                    return attempt::retry;
+                continue;
+            }
+            if (unlink && !upgrade(parent, p_version))
+                return attempt::retry;
+            if (!upgrade(n, version)) {
+                if (unlink)
+                    unlock(parent);
+                return attempt::retry;
+            }
+            bool collapse = unlink && parent->count() == 1;
+            if (collapse && parent != _root.load(std::memory_order_relaxed)) {
+                unlock(n);
+                unlock(parent);
+                return attempt::retry;
+            }
+            std::copy(vals + idx + 1, vals + count, vals + idx);
+            n->store(vals, count - 1);
+            n->_count.store(count - 1, std::memory_order_relaxed);
+            if (collapse) {
+                auto first = parent->_children[0].load(std::memory_order_relaxed);
+                _root.store(first != n ? first : parent->_children[1].load(std::memory_order_relaxed),
+                            std::memory_order_release);
+                unlock_obsolete(n);
+                unlock_obsolete(parent);
+                btree_epoch::retire(n);
+                btree_epoch::retire(parent);
+            } else if (unlink) {
+                remove_child(parent, n);
+                unlock_obsolete(n);
+                unlock(parent);
+                btree_epoch::retire(n);
+            } else {
+                unlock(n);
+            }
+            _size.fetch_sub(1, std::memory_order_relaxed);
+            return attempt::yes;
+        }
+    }
+
+    /**
+     * Splits the full node n in two, giving the upper half to a new node
+     * placed after it in parent, or under a new root if n is the root.
+     * Both n and parent are locked.
+     */
+    void split(inode* parent, node* n) {
+        T vals[N];
+        auto count = n->count();
+        n->load(vals, count);
+        auto mid = count / 2;
+        node* right;
+        T sep;
+        if (n->_leaf) {
+            // The separator is the last element left behind
+            right = new node(true);
+            right->store(vals + mid, count - mid);
+            right->_count.store(count - mid, std::memory_order_relaxed);
+            sep = vals[mid - 1];
+            n->_count.store(mid, std::memory_order_relaxed);
+        } else {
+            // The separator moves up out of n
+            auto in = static_cast<inode*>(n);
+            auto r_in = new inode();
+            r_in->store(vals + mid + 1, count - mid - 1);
+            // Slots left behind are cleared, a reader misled by a torn count
+            // must not find a subtree in them that may later be freed
+            for (size_t i = mid + 1; i <= count; ++i) {
+                r_in->_children[i - mid - 1].store(in->_children[i].load(std::memory_order_relaxed),
+                                                   std::memory_order_relaxed);
+                in->_children[i].store(nullptr, std::memory_order_relaxed);
+            }
+            r_in->_count.store(count - mid - 1, std::memory_order_relaxed);
+            sep = vals[mid];
+            n->_count.store(mid, std::memory_order_relaxed);
+            right = r_in;
+        }
+        if (!parent) {
+            auto root = new inode();
+            root->store(&sep, 1);
+            root->_children[0].store(n, std::memory_order_relaxed);
+            root->_children[1].store(right, std::memory_order_relaxed);
+            root->_count.store(1, std::memory_order_relaxed);
+            _root.store(root, std::memory_order_release);
+            return;
+        }
+        auto p_count = parent->count();
+        parent->load(vals, p_count);
+        auto idx = index_of(parent, n);
+        std::copy_backward(vals + idx, vals + p_count, vals + p_count + 1);
+        vals[idx] = sep;
+        parent->store(vals, p_count + 1);
+        for (auto i = p_count; i > idx; --i)
+            parent->_children[i + 1].store(parent->_children[i].load(std::memory_order_relaxed),
+                                           std::memory_order_relaxed);
+        parent->_children[idx + 1].store(right, std::memory_order_release);
+        parent->_count.store(p_count + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Gives the internal node n, down to one separator, a subtree from its
+     * neighbour, or merges the two when the neighbour is down to one too,
+     * so n can lose a subtree and keep one separator. Merging no fuller
+     * nodes keeps a merge from leaving a node that the next insert through
+     * it splits again. A root parent left with no separator by the merge is
+     * replaced by the merged node. Locks parent, n and the neighbour if
+     * they are still at the versions read.
+     *
+     * @return whether n was refilled, else the caller has to retry.
+     */
+    bool refill(inode* parent, uint64_t p_version, inode* n, uint64_t version) {
+        if (!upgrade(parent, p_version))
+            return false;
+        if (!upgrade(n, version)) {
+            unlock(parent);
+            return false;
+        }
+        auto p_count = parent->count();
+        auto idx = index_of(parent, n);
+        auto s_idx = idx < p_count ? idx + 1 : idx - 1;
+        auto sibling = static_cast<inode*>(parent->_children[s_idx].load(std::memory_order_relaxed));
+        auto s_version = sibling->_version.load(std::memory_order_acquire);
+        bool merge = sibling->count() == 1;
+        bool empties = merge && p_count == 1;
+        bool locked = !(s_version & (kLocked | kObsolete)) && upgrade(sibling, s_version);
+        if (!locked || (empties && parent != _root.load(std::memory_order_relaxed))) {
+            if (locked)
+                unlock(sibling);
+            unlock(n);
+            unlock(parent);
+            return false;
+        }
+        auto left = idx < s_idx ? n : sibling;
+        auto right = idx < s_idx ? sibling : n;
+        auto sep = std::min(idx, s_idx);
+        if (!merge) {
+            rotate(parent, sep, left, right, left == n);
+            unlock(sibling);
+            unlock(n);
+            unlock(parent);
+            return true;
+        }
+        merge_right(parent, sep, left, right);
+        unlock_obsolete(right);
+        unlock(left);
+        if (empties) {
+            _root.store(left, std::memory_order_release);
+            unlock_obsolete(parent);
+            btree_epoch::retire(parent);
+        } else {
+            unlock(parent);
+        }
+        btree_epoch::retire(right);
+        return true;
+    }
+    /**
+     * Moves one subtree across the separator sep of parent, from right to
+     * the end of left if to_left, else from left to the start of right,
+     * the separator rotating through parent. All three are locked.
+     */
+    static void rotate(inode* parent, size_t sep, inode* left, inode* right, bool to_left) {
+        T p_vals[N], l_vals[N], r_vals[N] = {};
+        auto p_count = parent->count();
+        auto l_count = left->count();
+        auto r_count = right->count();
+        parent->load(p_vals, p_count);
+        left->load(l_vals, l_count);
+        right->load(r_vals, r_count);
+        if (to_left) {
+            l_vals[l_count] = p_vals[sep];
+            p_vals[sep] = r_vals[0];
+            std::copy(r_vals + 1, r_vals + r_count, r_vals);
+            left->_children[l_count + 1].store(right->_children[0].load(std::memory_order_relaxed),
+                                               std::memory_order_relaxed);
+            for (size_t i = 0; i < r_count; ++i)
+                right->_children[i].store(right->_children[i + 1].load(std::memory_order_relaxed),
+                                          std::memory_order_relaxed);
+            right->_children[r_count].store(nullptr, std::memory_order_relaxed);
+            ++l_count;
+            --r_count;
+        } else {
+            std::copy_backward(r_vals, r_vals + r_count, r_vals + r_count + 1);
+            r_vals[0] = p_vals[sep];
+            p_vals[sep] = l_vals[l_count - 1];
+            for (auto i = r_count + 1; i > 0; --i)
+                right->_children[i].store(right->_children[i - 1].load(std::memory_order_relaxed),
+                                          std::memory_order_relaxed);
+            right->_children[0].store(left->_children[l_count].load(std::memory_order_relaxed),
+                                      std::memory_order_relaxed);
+            left->_children[l_count].store(nullptr, std::memory_order_relaxed);
+            --l_count;
+            ++r_count;
+        }
+        parent->store(p_vals, p_count);
+        left->store(l_vals, l_count);
+        left->_count.store(l_count, std::memory_order_relaxed);
+        right->store(r_vals, r_count);
+        right->_count.store(r_count, std::memory_order_relaxed);
+    }
+    /**
+     * Moves right's separators and subtrees onto the end of left, with the
+     * separator sep of parent between them, and takes right and that
+     * separator out of parent. All three are locked.
+     */
+    static void merge_right(inode* parent, size_t sep, inode* left, inode* right) {
+        T p_vals[N], vals[N];
+        auto p_count = parent->count();
+        auto l_count = left->count();
+        auto r_count = right->count();
+        parent->load(p_vals, p_count);
+        left->load(vals, l_count);
+        vals[l_count] = p_vals[sep];
+        right->load(vals + l_count + 1, r_count);
+        for (size_t i = 0; i <= r_count; ++i)
+            left->_children[l_count + 1 + i].store(right->_children[i].load(std::memory_order_relaxed),
+                                                   std::memory_order_relaxed);
+        left->store(vals, l_count + 1 + r_count);
+        left->_count.store(l_count + 1 + r_count, std::memory_order_relaxed);
+        std::copy(p_vals + sep + 1, p_vals + p_count, p_vals + sep);
+        for (auto i = sep + 1; i < p_count; ++i)
+            parent->_children[i].store(parent->_children[i + 1].load(std::memory_order_relaxed),
+                                       std::memory_order_relaxed);
+        parent->_children[p_count].store(nullptr, std::memory_order_relaxed);
+        parent->store(p_vals, p_count - 1);
+        parent->_count.store(p_count - 1, std::memory_order_relaxed);
+    }
+    // Where n is among the subtrees of parent, which is locked
+    static size_t index_of(const inode* parent, const node* n) {
+        size_t idx = 0;
+        while (parent->_children[idx].load(std::memory_order_relaxed) != n)
+            ++idx;
+        return idx;
+    }
+
+    /**
+     * Takes the subtree n out of parent, with the separator beside it. Keys
+     * that led to n then lead to a neighbour. Both are locked.
+     */
+    static void remove_child(inode* parent, node* n) {
+        T vals[N];
+        auto p_count = parent->count();
+        parent->load(vals, p_count);
+        auto idx = index_of(parent, n);
+        auto sep = std::min(idx, p_count - 1);
+        std::copy(vals + sep + 1, vals + p_count, vals + sep);
+        parent->store(vals, p_count - 1);
+        for (auto i = idx; i < p_count; ++i)
+            parent->_children[i].store(parent->_children[i + 1].load(std::memory_order_relaxed),
+                                       std::memory_order_relaxed);
+        parent->_children[p_count].store(nullptr, std::memory_order_relaxed);
+        parent->_count.store(p_count - 1, std::memory_order_relaxed);
+    }
+
+    static void destroy(node* n) {
+        if (n->_leaf) {
+            delete n;
+            return;
+        }
+        auto in = static_cast<inode*>(n);
+        for (size_t i = 0; i <= in->count(); ++i)
+            destroy(in->_children[i].load());
+        delete in;
+    }
+
+    std::atomic<node*> _root;
+    std::atomic<size_t> _size;
+    Compare _comp;
+};
+
+#endif
@@ -0,0 +1,394 @@
+/**
+ * A btree split by key range into shards, each a btree of its own behind
+ * its own lock, so writers to different ranges never meet. Splitter keys
+ * route every call to the one shard that can hold its key, and move when
+ * shards grow lopsided, handing elements to a neighbour.
+ */
+
+#ifndef SHARDED_BTREE_H
+#define SHARDED_BTREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+#include "btree_epoch.h"
+
+/**
+ * sharded_btree<T, N> holds unique elements ordered by Compare in K
+ * btree<T, N>s. Given K - 1 sorted splitters s, shard i holds the elements
+ * from s[i - 1] up to but not including s[i], the first and last shards
+ * being open at their ends.
+ *
+ * Calls from any number of threads may run at once; each locks only the
+ * shard it routes to. Every kCheckEvery inserts a shard compares itself
+ * with the mean, and past twice that hands up to kCheckEvery elements to
+ * each neighbour, so a lopsided shard is drained a little at a time and no
+ * insert holds locks for long. rebalance() evens out all the shards at once.
+ *
+ * Iterators run through the shards in turn, so in order, but are not
+ * synchronised with writers: use them while no thread writes, or use
+ * for_each, which locks each shard as it goes.
+ */
+template <typename T, size_t N = 0, typename Compare = std::less<T>>
+class sharded_btree {
+public:
+    using tree_type = btree<T, N, false, Compare>;
+    using key_type = T;
+    using value_type = T;
+    using key_compare = Compare;
+    class const_iterator;
+    using iterator = const_iterator;
+
+    /**
+     * Constructs empty shards, one more than there are splitters.
+     *
+     * @param splitters the keys the shards start at, after the first.
+     * @param maxNodeElems the node size of each shard, see btree.
+     * @param comp the ordering of the elements.
+     */
+    sharded_btree(std::vector<T> splitters, size_t maxNodeElems = N ? N : 40, const Compare& comp = Compare())
+        : _comp(comp) {
+        std::sort(splitters.begin(), splitters.end(), _comp);
+        for (size_t i = 0; i <= splitters.size(); ++i) {
+            _shards.emplace_back(new shard(maxNodeElems, comp));
+            auto &s = *_shards.back();
+            s._has_lo = i > 0;
+            s._has_hi = i < splitters.size();
+            if (s._has_lo)
+                s._lo = splitters[i - 1];
+            if (s._has_hi)
+                s._hi = splitters[i];
+        }
+        _splitters.store(new std::vector<T>(std::move(splitters)));
+    }
+
+    // Shards hold locks, which do not copy
+    sharded_btree(const sharded_btree&) = delete;
+    sharded_btree& operator=(const sharded_btree&) = delete;
+
+    /**
+     * No other thread may be using the tree.
+     */
+    ~sharded_btree() {
+        delete _splitters.load();
+    }
+
+    /**
+     * Inserts elem into its shard, unless it is already there.
+     *
+     * @return true if elem was inserted.
+     */
+    bool insert(const T& elem) {
+        return insert_elem(elem);
+    }
+    bool insert(T&& elem) {
+        return insert_elem(std::move(elem));
+    }
+
+    /**
+     * Removes the element equivalent to key, if there is one.
+     *
+     * @return the number of elements removed, 0 or 1.
+     */
+    size_t erase(const T& key) {
+        return with_shard(key, [&key] (shard& s, size_t) {
+            auto res = s._tree.erase(key);
+            s._size.store(s._tree.size(), std::memory_order_relaxed);
+            return res;
+        });
+    }
+
+    size_t count(const T& key) const {
+        return with_shard(key, [&key] (shard& s, size_t) -> size_t {
+            return s._tree.find(key) != s._tree.end();
+        });
+    }
+    bool contains(const T& key) const {
+        return count(key) != 0;
+    }
+
+    /**
+     * The number of elements, summed over shards other threads may be
+     * changing.
+     */
+    size_t size() const {
+        size_t res = 0;
+        for (auto &s : _shards)
+            res += s->_size.load(std::memory_order_relaxed);
+        return res;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    size_t shards() const {
+        return _shards.size();
+    }
+    size_t shard_size(size_t idx) const {
+        return _shards[idx]->_size.load(std::memory_order_relaxed);
+    }
+    key_compare key_comp() const {
+        return _comp;
+    }
+
+    /**
+     * Calls f on every element in order, locking one shard at a time. Each
+     * shard is seen as it was at some moment, not all at the same one.
+     */
+    template <typename F>
+    void for_each(F f) const {
+        for (auto &s : _shards) {
+            std::lock_guard<std::mutex> guard(s->_lock);
+            for (const auto &elem : s->_tree)
+                f(elem);
+        }
+    }
+
+    /**
+     * Moves splitters so every shard holds as near the same number of
+     * elements as it can. Elements only pass between neighbours, so a pass
+     * from the right gathers any surplus into the first shard, and a pass
+     * from the left then deals it out.
+     */
+    void rebalance() {
+        std::lock_guard<std::mutex> guard(_rebalance_lock);
+        rebalance_all();
+    }
+
+    const_iterator begin() const {
+        const_iterator res(this, 0, _shards[0]->_tree.begin());
+        res.skip_empty();
+        return res;
+    }
+    const_iterator end() const {
+        return const_iterator(this, _shards.size() - 1, _shards.back()->_tree.end());
+    }
+    const_iterator cbegin() const {
+        return begin();
+    }
+    const_iterator cend() const {
+        return end();
+    }
+
+    /**
+     * Walks the shards one after the other; their ranges follow each other,
+     * so the elements come out in order without any merging.
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        reference operator*() const {
+            return *_pos;
+        }
+        pointer operator->() const {
+            return &operator*();
+        }
+        const_iterator& operator++() {
+            ++_pos;
+            skip_empty();
+            return *this;
+        }
+        const_iterator operator++(int) {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+        bool operator==(const const_iterator& other) const {
+            return _shard == other._shard && _pos == other._pos;
+        }
+        bool operator!=(const const_iterator& other) const {
+            return !operator==(other);
+        }
+
+    private:
+        friend class sharded_btree;
+        using tree_iterator = typename tree_type::const_iterator;
+
+        const_iterator(const sharded_btree *owner, size_t shard, tree_iterator pos) :
+            _owner(owner), _shard(shard), _pos(pos) {};
+
+        // Steps over the ends of shards into the next that has elements
+        void skip_empty() {
+            auto &shards = _owner->_shards;
+            while (_shard + 1 < shards.size() && _pos == shards[_shard]->_tree.end())
+                _pos = shards[++_shard]->_tree.begin();
+        }
+
+        const sharded_btree *_owner;
+        size_t _shard;
+        tree_iterator _pos;
+    };
+
+private:
+    // Inserts a shard takes between looking at its size
+    static constexpr size_t kCheckEvery = 4096;
+
+    /**
+     * A btree and the range of keys it holds, both under _lock. _size is
+     * the tree's size, written under the lock for others to read without.
+     */
+    struct shard {
+        shard(size_t maxNodeElems, const Compare& comp) : _tree(maxNodeElems, comp), _size(0), _inserts(0) {};
+
+        std::mutex _lock;
+        tree_type _tree;
+        std::atomic<size_t> _size;
+        size_t _inserts;
+        T _lo;
+        T _hi;
+        bool _has_lo;
+        bool _has_hi;
+    };
+
+    bool holds(const shard& s, const T& key) const {
+        return (!s._has_lo || !_comp(key, s._lo)) && (!s._has_hi || _comp(key, s._hi));
+    }
+
+    /**
+     * Calls f with the shard key belongs in, and its index, locked. The
+     * splitters are read inside an epoch as rebalancing replaces them, and
+     * the shard's own range is checked once it is locked, in case they were
+     * replaced in between.
+     */
+    template <typename F>
+    auto with_shard(const T& key, F f) const -> decltype(f(std::declval<shard&>(), 0)) {
+        for (;;) {
+            size_t idx;
+            {
+                btree_epoch::guard guard;
+                auto splitters = _splitters.load(std::memory_order_acquire);
+                idx = std::upper_bound(splitters->begin(), splitters->end(), key, _comp) - splitters->begin();
+            }
+            auto &s = *_shards[idx];
+            std::lock_guard<std::mutex> guard(s._lock);
+            if (holds(s, key))
+                return f(s, idx);
+        }
+    }
+
+    template <typename V>
+    bool insert_elem(V&& elem) {
+        bool check = false;
+        size_t idx = 0;
+        auto res = with_shard(elem, [&] (shard& s, size_t i) {
+            auto inserted = s._tree.insert(std::forward<V>(elem)).second;
+            s._size.store(s._tree.size(), std::memory_order_relaxed);
+            idx = i;
+            check = inserted && ++s._inserts % kCheckEvery == 0;
+            return inserted;
+        });
+        if (check)
+            rebalance_near(idx);
+        return res;
+    }
+
+    /**
+     * Once shard idx holds more than twice the mean, moves up to
+     * kCheckEvery of its elements to each neighbour, no further than evens
+     * the pair out, unless another thread is rebalancing.
+     */
+    void rebalance_near(size_t idx) {
+        if (shard_size(idx) <= 2 * (size() / _shards.size()) + kCheckEvery)
+            return;
+        std::unique_lock<std::mutex> guard(_rebalance_lock, std::try_to_lock);
+        if (!guard)
+            return;
+        size_t step = kCheckEvery;
+        if (idx > 0)
+            even_pair(idx - 1, [step] (size_t left, size_t pair) {
+                return std::max(left, std::min(left + step, pair / 2));
+            });
+        if (idx + 1 < _shards.size())
+            even_pair(idx, [step] (size_t left, size_t pair) {
+                return std::min(left, std::max(left > step ? left - step : 0, pair / 2));
+            });
+    }
+    /**
+     * rebalance(), holding _rebalance_lock.
+     */
+    void rebalance_all() {
+        auto count = _shards.size();
+        auto total = size();
+        auto target = [total, count] (size_t i) {
+            return total * (i + 1) / count - total * i / count;
+        };
+        for (size_t i = count - 1; i > 0; --i)
+            even_pair(i - 1, [&] (size_t, size_t pair) { return pair - std::min(target(i), pair); });
+        for (size_t i = 0; i + 1 < count; ++i)
+            even_pair(i, [&] (size_t, size_t pair) { return std::min(target(i), pair); });
+    }
+    /**
+     * Locks shards idx and idx + 1 and evens them out, the first keeping
+     * want(elements in it, elements in both).
+     */
+    template <typename F>
+    void even_pair(size_t idx, F want) {
+        std::lock_guard<std::mutex> l_guard(_shards[idx]->_lock);
+        std::lock_guard<std::mutex> r_guard(_shards[idx + 1]->_lock);
+        auto left = _shards[idx]->_tree.size();
+        even(idx, want(left, left + _shards[idx + 1]->_tree.size()));
+    }
+
+    /**
+     * Moves the splitter between shards idx and idx + 1 so the first holds
+     * want of their elements, moving only the elements that change shard,
+     * across the boundary one at a time. Holds _rebalance_lock and both
+     * shards' locks.
+     */
+    void even(size_t idx, size_t want) {
+        auto &left = *_shards[idx];
+        auto &right = *_shards[idx + 1];
+        auto total = left._tree.size() + right._tree.size();
+        // With nothing past it, the last shard keeps an element to split at
+        if (want == total && !right._has_hi && total > 0)
+            --want;
+        if (want == left._tree.size())
+            return;
+        // Each moves to the near end of the other, where a hinted insert
+        // puts it straight into the end leaf
+        while (left._tree.size() > want) {
+            auto last = std::prev(left._tree.end());
+            T elem = *last;
+            left._tree.erase(last);
+            right._tree.insert(right._tree.cbegin(), std::move(elem));
+        }
+        while (left._tree.size() < want) {
+            auto first = right._tree.begin();
+            T elem = *first;
+            right._tree.erase(first);
+            left._tree.insert(left._tree.cend(), std::move(elem));
+        }
+        left._size.store(want, std::memory_order_relaxed);
+        right._size.store(total - want, std::memory_order_relaxed);
+        T sep = want < total ? *right._tree.begin() : right._hi;
+        left._hi = sep;
+        left._has_hi = true;
+        right._lo = sep;
+        right._has_lo = true;
+
+        auto old = _splitters.load(std::memory_order_relaxed);
+        auto next = new std::vector<T>(*old);
+        (*next)[idx] = sep;
+        _splitters.store(next, std::memory_order_release);
+        btree_epoch::retire(old);
+    }
+
+    std::vector<std::unique_ptr<shard>> _shards;
+    std::atomic<std::vector<T>*> _splitters;
+    std::mutex _rebalance_lock;
+    Compare _comp;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * Sequential insert benchmark.
+ * Inserts 0..n-1 in ascending order, the worst case for a tree that does
+ * not rebalance, then times a fixed number of lookups and counts the
+ * comparisons each makes. Splitting keeps the height O(log n), so the
+ * comparisons per find grow by a constant step each time n grows tenfold,
+ * where an unbalanced tree would need n / 2. The time per find rises
+ * faster than that: once the tree outgrows the caches, each level of the
+ * descent is a cache miss.
+ **/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "btree.h"
+
+namespace {
+
+const long kLookups = 200000;
+
+size_t comparisons = 0;
+
+// std::less<long>, counting its calls
+struct counting_less {
+  bool operator()(long a, long b) const {
+    ++comparisons;
+    return a < b;
+  }
+};
+
+template <typename Tree>
+double nsPerFind(const Tree& b, long n) {
+  auto start = std::chrono::steady_clock::now();
+  long found = 0;
+  for (long i = 0; i < kLookups; ++i) {
+    long key = (i * 7919) % n;
+    if (b.find(key) != b.end())
+      ++found;
+  }
+  auto stop = std::chrono::steady_clock::now();
+  if (found != kLookups) {
+    std::cout << "- lookup missed " << kLookups - found << " keys!" << std::endl;
+    std::exit(1);
+  }
+  return std::chrono::duration<double, std::nano>(stop - start).count() / kLookups;
+}
+
+}  // namespace close
+
+int main(void) {
+  for (long n = 1000; n <= 1000000; n *= 10) {
+    btree<long> b(40);
+    btree<long, 0, false, counting_less> counted(40);
+    for (long i = 0; i < n; ++i) {
+      b.insert(i);
+      counted.insert(i);
+    }
+    auto ns = nsPerFind(b, n);
+    comparisons = 0;
+    nsPerFind(counted, n);
+    std::cout << "n = " << n << ": " << ns << " ns/find, "
+              << double(comparisons) / kLookups << " comparisons/find" << std::endl;
+  }
+  return 0;
+}
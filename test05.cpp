@@ -0,0 +1,74 @@
+/**
+ * Erase test.
+ * Mirrors random inserts and erases into a btree and a std::set, erasing
+ * both by value and through iterators, and checks the two agree after
+ * every round, including once the tree has been emptied completely.
+ **/
+
+#include <cstdlib>
+#include <iostream>
+#include <set>
+
+#include "btree.h"
+
+namespace {
+
+const long kMaxValue = 5000;
+
+bool matches(const btree<long>& b, const std::set<long>& s) {
+  auto iter = b.begin();
+  for (auto val : s) {
+    if (iter == b.end() || *iter != val)
+      return false;
+    ++iter;
+  }
+  if (iter != b.end())
+    return false;
+  for (long i = 0; i < kMaxValue; ++i) {
+    if ((b.find(i) != b.end()) != (s.find(i) != s.end()))
+      return false;
+  }
+  return true;
+}
+
+void eraseRound(btree<long>& b, std::set<long>& s) {
+  for (long i = 0; i < 2 * kMaxValue; ++i) {
+    long val = random() % kMaxValue;
+    b.insert(val);
+    s.insert(val);
+  }
+  for (long i = 0; i < kMaxValue; ++i) {
+    long val = random() % kMaxValue;
+    if (b.erase(val) != s.erase(val)) {
+      std::cout << "- erase disagreed on " << val << std::endl;
+      return;
+    }
+  }
+  // every other element, through iterators
+  for (auto iter = b.begin(); iter != b.end();) {
+    s.erase(*iter);
+    iter = b.erase(iter);
+    if (iter != b.end())
+      ++iter;
+  }
+}
+
+}  // namespace close
+
+int main(void) {
+  srandom(6771);
+  for (size_t maxNodeElems : {2, 3, 4, 7, 40}) {
+    btree<long> b(maxNodeElems);
+    std::set<long> s;
+    for (int round = 0; round < 3; ++round)
+      eraseRound(b, s);
+    bool ok = matches(b, s);
+    for (auto val : s)
+      b.erase(val);
+    s.clear();
+    ok = ok && matches(b, s) && b.begin() == b.end();
+    std::cout << "maxNodeElems " << maxNodeElems << ": "
+              << (ok ? "btree checks out just fine" : "btree and set differ") << std::endl;
+  }
+  return 0;
+}
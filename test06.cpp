@@ -0,0 +1,65 @@
+/**
+ * Copy benchmark.
+ * Builds the test01 workload (up to 1M random longs, 99 per node) and times
+ * the structural copy constructor against rebuilding the tree by
+ * reinserting every element, which is what copying used to do. Copying
+ * reinserted in breadth-first order, far from sorted, so the elements are
+ * reinserted here in a shuffled order rather than sorted.
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+
+long getRandom(long low, long high) {
+  return (low + (random() % ((high - low) + 1)));
+}
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+}  // namespace close
+
+int main(void) {
+  srandom(6771);
+  btree<long> original(99);
+  for (size_t i = 0; i < 1000000; i++)
+    original.insert(getRandom(kMinInteger, kMaxInteger));
+
+  std::vector<long> order(original.begin(), original.end());
+  std::shuffle(order.begin(), order.end(), std::minstd_rand(6771));
+  btree<long> reinserted(99);
+  double reinsertMs = timeMs([&] {
+    for (auto val : order)
+      reinserted.insert(val);
+  });
+
+  btree<long> *cloned = nullptr;
+  double cloneMs = timeMs([&] {
+    cloned = new btree<long>(original);
+  });
+
+  bool same = std::equal(original.begin(), original.end(), cloned->begin()) &&
+              std::equal(original.begin(), original.end(), reinserted.begin());
+  delete cloned;
+
+  std::cout << "reinsert copy: " << reinsertMs << " ms" << std::endl;
+  std::cout << "clone copy:    " << cloneMs << " ms" << std::endl;
+  std::cout << (same ? "- copies check out just fine." : "- copies differ!") << std::endl;
+  return same ? 0 : 1;
+}
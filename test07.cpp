@@ -0,0 +1,62 @@
+/**
+ * Bulk load benchmark.
+ * Times building a btree from 1M sorted longs by inserting them one at a
+ * time against assign(), at a couple of fill factors, and checks the
+ * trees agree. Also bulk loads the words in twl.txt, which are stored in
+ * descending order, by reading them back to front.
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+}  // namespace close
+
+int main(void) {
+  std::vector<long> sorted;
+  for (long i = 0; i < 1000000; ++i)
+    sorted.push_back(i * 3);
+
+  btree<long> inserted(99);
+  double insertMs = timeMs([&] {
+    for (auto val : sorted)
+      inserted.insert(val);
+  });
+  std::cout << "insert one by one: " << insertMs << " ms" << std::endl;
+
+  bool ok = true;
+  for (double fill : {1.0, 0.7}) {
+    btree<long> loaded(99);
+    double loadMs = timeMs([&] {
+      loaded.assign(sorted.begin(), sorted.end(), fill);
+    });
+    ok = ok && std::equal(sorted.begin(), sorted.end(), loaded.begin());
+    std::cout << "assign, fill " << fill << ": " << loadMs << " ms" << std::endl;
+  }
+
+  std::ifstream wordFile("twl.txt");
+  std::vector<std::string> words;
+  std::string word;
+  while (getline(wordFile, word))
+    words.push_back(word);
+  btree<std::string> strTable(words.rbegin(), words.rend());
+  ok = ok && std::equal(words.rbegin(), words.rend(), strTable.begin());
+
+  std::cout << (ok ? "- bulk loads check out just fine." : "- bulk loads differ!") << std::endl;
+  return ok ? 0 : 1;
+}
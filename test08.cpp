@@ -0,0 +1,79 @@
+/**
+ * Iteration and lookup benchmark against std::set.
+ * Loads the same 1M random longs into a std::set, a btree sized at run
+ * time and a btree with the same node capacity fixed at compile time, then
+ * times a full in-order scan and a round of successful finds on each.
+ * Also reports how many bytes of node memory each btree uses per element.
+ **/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+
+long getRandom(long low, long high) {
+  return (low + (random() % ((high - low) + 1)));
+}
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <typename Container>
+void report(const char *name, const Container& c, const std::vector<long>& keys) {
+  long sum = 0;
+  double scanMs = timeMs([&] {
+    for (auto iter = c.begin(); iter != c.end(); ++iter)
+      sum += *iter;
+  });
+  size_t found = 0;
+  double findMs = timeMs([&] {
+    for (auto key : keys)
+      found += (c.find(key) != c.end());
+  });
+  std::cout << name << ": scan " << scanMs << " ms, find " << findMs
+            << " ms (checksum " << sum << ", found " << found << ")" << std::endl;
+}
+
+template <typename Tree>
+void footprint(const char *name, const Tree& b, size_t size) {
+  auto stats = b.slab_usage();
+  std::cout << name << ": " << static_cast<double>(stats.used_bytes) / size
+            << " bytes/element in nodes, " << stats.slab_bytes / 1024 << " KiB in "
+            << stats.slabs << " slabs" << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  srandom(6771);
+  btree<long> b(40);
+  btree<long, 40> fixed;
+  std::set<long> s;
+  std::vector<long> keys;
+  for (size_t i = 0; i < 1000000; i++) {
+    long val = getRandom(kMinInteger, kMaxInteger);
+    b.insert(val);
+    fixed.insert(val);
+    s.insert(val);
+    keys.push_back(val);
+  }
+  report("std::set", s, keys);
+  report("btree   ", b, keys);
+  report("btree<N>", fixed, keys);
+  footprint("btree   ", b, s.size());
+  footprint("btree<N>", fixed, s.size());
+  return 0;
+}
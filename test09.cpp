@@ -0,0 +1,116 @@
+/**
+ * Allocation test.
+ * Replaces the global operator new to count heap allocations, then checks
+ * that lookups and iteration over a btree<std::string> with keys too long
+ * for the small string optimisation never allocate: find (hits and misses),
+ * begin, end and stepping an iterator across the whole tree both ways.
+ * Also checks that nodes come from the tree's slabs: refilling a tree
+ * after emptying it reuses freed nodes, and a copy allocates once per
+ * slab rather than once per node.
+ **/
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+size_t allocations = 0;
+
+}  // namespace close
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void *ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void *ptr) noexcept {
+  std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+template <typename F>
+void expectNoAllocations(const char *what, F f) {
+  auto before = allocations;
+  f();
+  auto count = allocations - before;
+  std::cout << what << ": " << count << " allocations" << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  btree<std::string> b(4);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000; ++i)
+    keys.push_back("a key too long to fit in place " + std::to_string(i * 2));
+  std::string missing = "a key too long to fit in place, but absent";
+
+  auto before = allocations;
+  for (const auto &key : keys)
+    b.insert(key);
+  std::cout << "insert allocates: " << (allocations > before ? "yes" : "no") << std::endl;
+
+  const btree<std::string> &cb = b;
+  size_t found = 0;
+  expectNoAllocations("find", [&] {
+    for (const auto &key : keys)
+      found += (b.find(key) != b.end());
+    found += (b.find(missing) != b.end());
+  });
+  expectNoAllocations("const find", [&] {
+    for (const auto &key : keys)
+      found += (cb.find(key) != cb.end());
+  });
+  expectNoAllocations("begin and end", [&] {
+    found += (b.begin() != b.end()) + (cb.cbegin() != cb.cend());
+  });
+  expectNoAllocations("increment", [&] {
+    for (auto iter = b.begin(); iter != b.end(); ++iter)
+      ++found;
+  });
+  expectNoAllocations("decrement", [&] {
+    auto iter = b.end();
+    while (iter != b.begin()) {
+      --iter;
+      ++found;
+    }
+  });
+  std::cout << "visited " << found << std::endl;
+
+  btree<long> numbers(4);
+  for (long i = 0; i < 10000; ++i)
+    numbers.insert(i);
+  expectNoAllocations("erase and reinsert", [&] {
+    for (long i = 0; i < 10000; ++i)
+      numbers.erase(i);
+    for (long i = 10000; i > 0; --i)
+      numbers.insert(i);
+  });
+  before = allocations;
+  btree<long> copy(numbers);
+  auto stats = copy.slab_usage();
+  // a node holds at most 4 elements, so per node allocation would be over 2500
+  std::cout << "copy allocates per slab, not per node: "
+            << (allocations - before < 100 ? "yes" : "no") << std::endl;
+  std::cout << "copy leaves nothing free: " << (stats.free_bytes == 0 ? "yes" : "no") << std::endl;
+  return 0;
+}
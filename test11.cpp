@@ -0,0 +1,58 @@
+/**
+ * Iterator ends test.
+ * Checks begin() and end() follow the smallest and largest elements as
+ * the tree grows and shrinks at both ends, that stepping back from end()
+ * reaches the largest element, and that an empty tree has begin() == end().
+ **/
+
+#include <iostream>
+
+#include "btree.h"
+
+namespace {
+
+void report(const char *name, const btree<int>& b) {
+  std::cout << name << ":";
+  if (b.begin() == b.end()) {
+    std::cout << " empty" << std::endl;
+    return;
+  }
+  auto last = b.end();
+  --last;
+  std::cout << " first " << *b.begin() << ", last " << *last
+            << ", last reversed " << *b.rbegin() << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  btree<int> b(4);
+  report("new tree", b);
+  for (int i = 100; i < 200; ++i)
+    b.insert(i);
+  report("100 to 199", b);
+  for (int i = 99; i >= 0; --i)
+    b.insert(i);
+  report("0 to 199", b);
+  for (int i = 0; i < 50; ++i)
+    b.erase(i);
+  for (int i = 150; i < 200; ++i)
+    b.erase(i);
+  report("50 to 149", b);
+
+  // one step past the last element is end(), and back again
+  auto iter = b.find(149);
+  ++iter;
+  std::cout << "past 149 is end: " << (iter == b.end()) << std::endl;
+  --iter;
+  std::cout << "back from end: " << *iter << std::endl;
+
+  btree<int> copy(b);
+  report("copy", copy);
+  for (int i = 50; i < 150; ++i)
+    b.erase(i);
+  report("emptied", b);
+  b.insert(7);
+  report("refilled", b);
+  return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * Full scan benchmark.
+ * Walks 1M random longs and 200k random strings front to back and back to
+ * front through btree iterators, at a small and a large node size, and
+ * through std::set iterators over the same elements, ten times each.
+ * The backward walk decrements from end() itself: a reverse_iterator
+ * decrements a copy on every dereference as well, which would time two
+ * steps per element.
+ **/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+const int kPasses = 10;
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+size_t weight(long val) { return static_cast<size_t>(val); }
+size_t weight(const std::string& val) { return val.size(); }
+
+template <typename Container>
+void report(const char *name, const Container& c) {
+  size_t sum = 0;
+  double forwardMs = timeMs([&] {
+    for (int pass = 0; pass < kPasses; ++pass)
+      for (auto iter = c.begin(); iter != c.end(); ++iter)
+        sum += weight(*iter);
+  });
+  double backwardMs = timeMs([&] {
+    for (int pass = 0; pass < kPasses; ++pass)
+      for (auto iter = c.end(); iter != c.begin();)
+        sum -= weight(*--iter);
+  });
+  std::cout << name << ": forward " << forwardMs << " ms, backward " << backwardMs
+            << " ms" << (sum == 0 ? "" : " (scans disagree)") << std::endl;
+}
+
+template <typename T>
+void compare(const char *name, const std::vector<T>& vals) {
+  std::set<T> s(vals.begin(), vals.end());
+  btree<T> small(4);
+  btree<T> large(40);
+  for (const auto& val : vals) {
+    small.insert(val);
+    large.insert(val);
+  }
+  std::cout << name << ", " << s.size() << " elements, " << kPasses << " passes" << std::endl;
+  report("  std::set     ", s);
+  report("  btree(4)     ", small);
+  report("  btree(40)    ", large);
+}
+
+}  // namespace close
+
+int main(void) {
+  srandom(6771);
+  std::vector<long> longs;
+  for (size_t i = 0; i < 1000000; i++)
+    longs.push_back(random());
+  compare("long", longs);
+
+  std::vector<std::string> strings;
+  for (size_t i = 0; i < 200000; i++) {
+    std::string str;
+    for (int len = 8 + random() % 16; len > 0; --len)
+      str += static_cast<char>('a' + random() % 26);
+    strings.push_back(str);
+  }
+  compare("std::string", strings);
+  return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * Leaf-linked scan benchmark.
+ * Loads the same 1M random longs into a std::set, a btree and a
+ * linked_btree, at run time and compile time node sizes, then times ten
+ * full scans and 100k short range scans starting from found elements.
+ * Also checks the trees agree with the set.
+ **/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+const int kPasses = 10;
+const int kRangeLength = 100;
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <typename Container>
+void report(const char *name, const Container& c, const std::set<long>& s,
+            const std::vector<long>& starts) {
+  if (!std::equal(s.begin(), s.end(), c.begin()) || !std::equal(s.rbegin(), s.rend(), c.rbegin()))
+    std::cout << name << " disagrees with std::set" << std::endl;
+  long sum = 0;
+  double scanMs = timeMs([&] {
+    for (int pass = 0; pass < kPasses; ++pass)
+      for (auto iter = c.begin(); iter != c.end(); ++iter)
+        sum += *iter;
+  });
+  double rangeMs = timeMs([&] {
+    for (auto start : starts) {
+      auto iter = c.find(start);
+      for (int i = 0; i < kRangeLength && iter != c.end(); ++i, ++iter)
+        sum += *iter;
+    }
+  });
+  std::cout << name << ": full scans " << scanMs << " ms, range scans " << rangeMs
+            << " ms (checksum " << sum << ")" << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  srandom(6771);
+  std::set<long> s;
+  btree<long> b(40);
+  btree<long, 40> fixed;
+  linked_btree<long> lb(40);
+  linked_btree<long, 40> lfixed;
+  std::vector<long> starts;
+  for (size_t i = 0; i < 1000000; i++) {
+    long val = random();
+    s.insert(val);
+    b.insert(val);
+    fixed.insert(val);
+    lb.insert(val);
+    lfixed.insert(val);
+    if (i % 10 == 0)
+      starts.push_back(val);
+  }
+  report("std::set           ", s, s, starts);
+  report("btree              ", b, s, starts);
+  report("btree<N>           ", fixed, s, starts);
+  report("linked_btree       ", lb, s, starts);
+  report("linked_btree<N>    ", lfixed, s, starts);
+  return 0;
+}
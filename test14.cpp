@@ -0,0 +1,76 @@
+/**
+ * Size, rank and select test.
+ * Mirrors random inserts and erases into a btree, a linked_btree and a
+ * std::set, checks size(), rank() and select() against positions in the
+ * set, and prints a few percentiles of what is left.
+ **/
+
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <set>
+
+#include "btree.h"
+
+namespace {
+
+const long kMaxValue = 100000;
+
+template <typename Tree>
+bool matches(const Tree& b, const std::set<long>& s) {
+  if (b.size() != s.size())
+    return false;
+  size_t idx = 0;
+  for (auto val : s) {
+    if (b.rank(val) != idx || *b.select(idx) != val)
+      return false;
+    ++idx;
+  }
+  if (b.select(idx) != b.end())
+    return false;
+  // elements that are not there rank where they would go
+  for (long val = -1; val <= kMaxValue; val += 997) {
+    if (b.rank(val) != static_cast<size_t>(std::distance(s.begin(), s.lower_bound(val))))
+      return false;
+  }
+  return true;
+}
+
+template <typename Tree>
+void test(const char *name, Tree& b) {
+  srandom(6771);
+  std::set<long> s;
+  bool ok = b.size() == 0 && b.select(0) == b.end() && b.rank(42) == 0;
+  for (int round = 0; round < 3; ++round) {
+    for (long i = 0; i < kMaxValue / 2; ++i) {
+      long val = random() % kMaxValue;
+      b.insert(val);
+      s.insert(val);
+    }
+    ok = ok && matches(b, s);
+    for (long i = 0; i < kMaxValue / 2; ++i) {
+      long val = random() % kMaxValue;
+      b.erase(val);
+      s.erase(val);
+    }
+    ok = ok && matches(b, s);
+  }
+  Tree copy(b);
+  ok = ok && matches(copy, s);
+
+  std::cout << name << ": " << b.size() << " elements, percentiles";
+  for (size_t pct : {0, 25, 50, 75, 99})
+    std::cout << ' ' << *b.select(b.size() * pct / 100);
+  std::cout << std::endl;
+  std::cout << (ok ? "- rank and select agree with std::set." : "- rank and select disagree!") << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  btree<long> b(16);
+  test("btree", b);
+  linked_btree<long, 5> lb;
+  test("linked_btree", lb);
+  return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * Range query test.
+ * Fills a btree, a linked_btree and a std::set with the same random
+ * values, then checks lower_bound, upper_bound and equal_range agree with
+ * the set, and that scanning [a, b) between the bounds visits the same
+ * elements. Prints a few of the ranges.
+ **/
+
+#include <cstdlib>
+#include <iostream>
+#include <set>
+
+#include "btree.h"
+
+namespace {
+
+const long kMaxValue = 10000;
+
+template <typename Iter, typename SetIter>
+bool sameSpot(Iter iter, Iter end, SetIter siter, SetIter send) {
+  if (siter == send)
+    return iter == end;
+  return iter != end && *iter == *siter;
+}
+
+template <typename Tree>
+bool boundsAgree(Tree& b, const std::set<long>& s) {
+  const Tree& cb = b;
+  for (long val = -1; val <= kMaxValue; ++val) {
+    auto sl = s.lower_bound(val);
+    auto su = s.upper_bound(val);
+    if (!sameSpot(b.lower_bound(val), b.end(), sl, s.end()) ||
+        !sameSpot(cb.lower_bound(val), cb.end(), sl, s.end()) ||
+        !sameSpot(b.upper_bound(val), b.end(), su, s.end()) ||
+        !sameSpot(cb.upper_bound(val), cb.end(), su, s.end()))
+      return false;
+    auto range = b.equal_range(val);
+    auto crange = cb.equal_range(val);
+    if (range.first != b.lower_bound(val) || range.second != b.upper_bound(val) ||
+        crange.first != cb.lower_bound(val) || crange.second != cb.upper_bound(val))
+      return false;
+  }
+  return true;
+}
+
+template <typename Tree>
+void test(const char *name, Tree& b) {
+  srandom(6771);
+  std::set<long> s;
+  for (long i = 0; i < kMaxValue / 4; ++i) {
+    long val = random() % kMaxValue;
+    b.insert(val);
+    s.insert(val);
+  }
+  bool ok = boundsAgree(b, s);
+  std::cout << name << ":" << std::endl;
+  for (int i = 0; i < 200; ++i) {
+    long low = random() % kMaxValue;
+    long high = low + random() % 50;
+    size_t count = 0;
+    long sum = 0;
+    for (auto iter = b.lower_bound(low); iter != b.lower_bound(high); ++iter) {
+      ++count;
+      sum += *iter;
+    }
+    size_t scount = 0;
+    long ssum = 0;
+    for (auto iter = s.lower_bound(low); iter != s.lower_bound(high); ++iter) {
+      ++scount;
+      ssum += *iter;
+    }
+    ok = ok && count == scount && sum == ssum;
+    if (i % 50 == 0)
+      std::cout << "  [" << low << ", " << high << ") holds " << count << " elements" << std::endl;
+  }
+  std::cout << (ok ? "- range queries agree with std::set." : "- range queries disagree!") << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  btree<long> b(6);
+  test("btree", b);
+  linked_btree<long> lb(6);
+  test("linked_btree", lb);
+  return 0;
+}
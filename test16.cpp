@@ -0,0 +1,64 @@
+/**
+ * Ordered ingest benchmark.
+ * Inserts 1M ascending longs into a btree through plain insert, which
+ * appends to the last leaf, and through insert with an end() hint, and
+ * 1M descending longs with a begin() hint, against std::set doing the
+ * same. Also checks the trees hold what was inserted.
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <typename Container>
+bool holds(const Container& c, const std::vector<long>& sorted) {
+  return c.size() == sorted.size() && std::equal(sorted.begin(), sorted.end(), c.begin());
+}
+
+template <typename Container>
+void report(const char *name, const std::vector<long>& sorted) {
+  Container plain, hinted, reversed;
+  double plainMs = timeMs([&] {
+    for (auto val : sorted)
+      plain.insert(val);
+  });
+  double hintedMs = timeMs([&] {
+    for (auto val : sorted)
+      hinted.insert(hinted.end(), val);
+  });
+  double reversedMs = timeMs([&] {
+    for (auto iter = sorted.rbegin(); iter != sorted.rend(); ++iter)
+      reversed.insert(reversed.begin(), *iter);
+  });
+  bool ok = holds(plain, sorted) && holds(hinted, sorted) && holds(reversed, sorted);
+  std::cout << name << ": ascending " << plainMs << " ms, ascending at end() "
+            << hintedMs << " ms, descending at begin() " << reversedMs << " ms"
+            << (ok ? "" : " (contents differ!)") << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  std::vector<long> sorted;
+  for (long i = 0; i < 1000000; ++i)
+    sorted.push_back(i * 7);
+  report<std::set<long>>("std::set           ", sorted);
+  report<btree<long>>("btree              ", sorted);
+  report<btree<long, 40>>("btree<N>           ", sorted);
+  report<linked_btree<long>>("linked_btree       ", sorted);
+  return 0;
+}
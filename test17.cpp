@@ -0,0 +1,155 @@
+/**
+ * Move-aware insertion test.
+ * Counts the copies and moves a btree makes of its elements as they are
+ * inserted by copy, by move, by emplace and by try_emplace, and checks
+ * try_emplace, given a bare key, constructs nothing for a key already
+ * there. Then fills a btree with a move-only type, erases half of it and
+ * checks what is left.
+ **/
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "btree.h"
+
+namespace {
+
+const long kCount = 2000;
+
+size_t copies = 0;
+size_t builds = 0;
+
+// Counts the copies made of it, and every time one is constructed
+struct counted {
+  long key;
+  std::string payload;
+  counted(long k = 0) : key(k) { ++builds; }
+  counted(long k, const std::string& p) : key(k), payload(p) { ++builds; }
+  counted(const counted& o) : key(o.key), payload(o.payload) {
+    ++copies;
+    ++builds;
+  }
+  counted(counted&& o) : key(o.key), payload(std::move(o.payload)) { ++builds; }
+  counted& operator=(const counted& o) {
+    key = o.key;
+    payload = o.payload;
+    ++copies;
+    return *this;
+  }
+  counted& operator=(counted&&) = default;
+  bool operator<(const counted& o) const { return key < o.key; }
+  bool operator==(const counted& o) const { return key == o.key; }
+};
+
+// Orders counted by key, and compares bare keys with them
+struct counted_less {
+  using is_transparent = void;
+  bool operator()(const counted& a, const counted& b) const { return a.key < b.key; }
+  bool operator()(const counted& a, long b) const { return a.key < b; }
+  bool operator()(long a, const counted& b) const { return a < b.key; }
+};
+
+// Can only be moved
+struct record {
+  long key;
+  std::unique_ptr<long> value;
+  record(long k = 0) : key(k), value(new long(k * k)) {}
+  bool operator<(const record& o) const { return key < o.key; }
+  bool operator==(const record& o) const { return key == o.key; }
+};
+
+long nextKey() {
+  return random() % (kCount * 4);
+}
+
+void countCopies() {
+  btree<counted> b(5);
+  srandom(6771);
+  for (long i = 0; i < kCount; ++i) {
+    counted c(nextKey());
+    b.insert(c);
+  }
+  std::cout << "insert(const T&) of " << kCount << " made " << copies << " copies" << std::endl;
+
+  btree<counted> mb(5);
+  copies = 0;
+  srandom(6771);
+  for (long i = 0; i < kCount; ++i)
+    mb.insert(counted(nextKey()));
+  std::cout << "insert(T&&) of " << kCount << " made " << copies << " copies" << std::endl;
+
+  btree<counted, 0, false, counted_less> eb(5);
+  copies = 0;
+  builds = 0;
+  srandom(6771);
+  for (long i = 0; i < kCount; ++i)
+    eb.emplace(nextKey(), "payload");
+  std::cout << "emplace of " << kCount << " made " << copies << " copies and "
+            << builds << " constructions" << std::endl;
+
+  copies = 0;
+  builds = 0;
+  size_t inserted = 0;
+  srandom(6771);
+  for (long i = 0; i < kCount; ++i) {
+    long key = nextKey();
+    inserted += eb.try_emplace(key, key, "payload").second;
+  }
+  std::cout << "try_emplace of the same keys inserted " << inserted << ", made "
+            << copies << " copies and " << builds << " constructions" << std::endl;
+
+  size_t fresh = 0;
+  builds = 0;
+  for (long key = 0; key < kCount * 4; ++key)
+    fresh += eb.try_emplace(key, key, "payload").second;
+  std::cout << "try_emplace of every key inserted " << fresh << " in "
+            << builds << " constructions" << std::endl;
+}
+
+void moveOnly() {
+  btree<record> b(4);
+  srandom(6771);
+  for (long i = 0; i < kCount; ++i) {
+    record r(nextKey());
+    b.insert(std::move(r));
+    b.emplace(nextKey());
+  }
+  long erased = 0;
+  for (auto iter = b.begin(); iter != b.end(); ++erased)
+    iter = b.erase(iter);
+  for (auto iter = b.begin(); iter != b.end(); ++iter)
+    ;
+  bool ok = b.begin() == b.end() && erased > 0;
+
+  btree<std::unique_ptr<long>> pb(4);
+  for (long i = 0; i < kCount; ++i)
+    pb.emplace(new long(i));
+  long sum = 0;
+  for (const auto& ptr : pb)
+    sum += *ptr;
+  ok = ok && sum == kCount * (kCount - 1) / 2;
+
+  btree<record> hb(4);
+  for (long i = 0; i < kCount; ++i)
+    hb.insert(hb.cend(), record(i));
+  for (long i = 0; i < kCount; i += 2)
+    hb.erase(record(i));
+  long left = 0;
+  for (const auto& r : hb) {
+    ok = ok && r.key % 2 == 1 && *r.value == r.key * r.key;
+    ++left;
+  }
+  ok = ok && left == kCount / 2;
+  std::cout << (ok ? "- move-only elements inserted, erased and read back." :
+                     "- move-only elements lost!") << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  countCopies();
+  moveOnly();
+  return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Three-way search benchmark.
+ * Loads the words of twl.txt into btrees of two string keys that count
+ * their comparisons, then finds every word many times over. One key has
+ * only operator< and operator==, the other also a btree_three_way
+ * comparison, so the search learns of a match without a second compare.
+ * Reports the comparisons per insert and per find, and the find times.
+ **/
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+const int kRounds = 200;
+
+size_t comparisons = 0;
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+// Compared with operator< and operator== only
+struct less_key {
+  std::string word;
+  less_key(const std::string& w = "") : word(w) {}
+  bool operator<(const less_key& o) const {
+    ++comparisons;
+    return word < o.word;
+  }
+  bool operator==(const less_key& o) const {
+    ++comparisons;
+    return word == o.word;
+  }
+};
+
+// Also compared three ways, see the btree_three_way specialisation below
+struct three_way_key : less_key {
+  three_way_key(const std::string& w = "") : less_key(w) {}
+};
+
+}  // namespace close
+
+template <>
+struct btree_three_way<three_way_key> {
+  static constexpr bool value = true;
+  static int compare(const three_way_key& a, const three_way_key& b) {
+    ++comparisons;
+    return a.word.compare(b.word);
+  }
+};
+
+namespace {
+
+template <typename Key>
+void report(const char *name, size_t nodeSize, const std::vector<std::string>& words) {
+  btree<Key> b(nodeSize);
+  std::vector<Key> keys(words.begin(), words.end());
+  comparisons = 0;
+  for (const auto& key : keys)
+    b.insert(key);
+  double perInsert = double(comparisons) / keys.size();
+  comparisons = 0;
+  size_t found = 0;
+  for (const auto& key : keys)
+    found += b.find(key) != b.end();
+  double perFind = double(comparisons) / keys.size();
+  double ms = timeMs([&] {
+    for (int i = 0; i < kRounds; ++i)
+      for (const auto& key : keys)
+        found += b.find(key) != b.end();
+  });
+  if (found != keys.size() * (kRounds + 1))
+    std::cout << "lost " << keys.size() * (kRounds + 1) - found << " words" << std::endl;
+  std::cout << name << " node size " << nodeSize << ": " << perInsert
+            << " comparisons per insert, " << perFind << " per find, "
+            << kRounds << " rounds of finds " << ms << " ms" << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  std::ifstream in("twl.txt");
+  std::vector<std::string> words;
+  std::string word;
+  while (in >> word)
+    words.push_back(word);
+  for (size_t nodeSize : {4, 16, 64}) {
+    report<less_key>("operator<  ", nodeSize, words);
+    report<three_way_key>("three-way  ", nodeSize, words);
+  }
+  return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * Custom ordering test.
+ * Orders words from twl.txt case-insensitively and random numbers in
+ * reverse, checking the btrees iterate and search as std::sets with the
+ * same comparators do. Then looks words up through a transparent
+ * comparator by const char*, counting how many keys get built on the way.
+ **/
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+struct case_less {
+  bool operator()(const std::string& a, const std::string& b) const {
+    return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+        [](char x, char y) { return std::tolower(x) < std::tolower(y); });
+  }
+};
+
+size_t built = 0;
+
+// A key that counts how often it is built from a C string
+struct word {
+  std::string text;
+  word(const char *t = "") : text(t) { ++built; }
+};
+
+struct word_less {
+  using is_transparent = void;
+  bool operator()(const word& a, const word& b) const { return a.text < b.text; }
+  bool operator()(const word& a, const char *b) const { return a.text.compare(b) < 0; }
+  bool operator()(const char *a, const word& b) const { return b.text.compare(a) > 0; }
+};
+
+template <typename Tree, typename Set>
+bool sameAsSet(const Tree& b, const Set& s) {
+  if (b.size() != s.size() || !std::equal(b.begin(), b.end(), s.begin()))
+    return false;
+  for (const auto& elem : s)
+    if (b.find(elem) == b.end() || *b.lower_bound(elem) != elem)
+      return false;
+  return true;
+}
+
+std::vector<std::string> readWords() {
+  std::ifstream in("twl.txt");
+  std::vector<std::string> words;
+  std::string w;
+  for (size_t i = 0; in >> w; ++i) {
+    // Every other word in lower case, so only case sets some apart
+    if (i % 2)
+      for (auto& c : w)
+        c = std::tolower(c);
+    words.push_back(w);
+  }
+  return words;
+}
+
+void caseInsensitive(const std::vector<std::string>& words) {
+  btree<std::string, 0, false, case_less> b(5);
+  linked_btree<std::string, 8, case_less> lb;
+  std::set<std::string, case_less> s;
+  for (const auto& w : words) {
+    b.insert(w);
+    lb.insert(w);
+    s.insert(w);
+  }
+  bool ok = sameAsSet(b, s) && sameAsSet(lb, s);
+  ok = ok && b.find("zyzzyva") != b.end() && !b.insert("ZYZZYVA").second;
+  std::cout << "case-insensitive: " << b.size() << " words, first " << *b.begin()
+            << ", last " << *b.rbegin() << std::endl;
+  std::cout << (ok ? "- agrees with std::set." : "- disagrees with std::set!") << std::endl;
+}
+
+void reversed() {
+  srandom(6771);
+  btree<long, 0, false, std::greater<long>> b(4);
+  btree<long, 16, false, std::greater<long>> fb;
+  std::set<long, std::greater<long>> s;
+  for (int i = 0; i < 5000; ++i) {
+    long val = random() % 10000;
+    b.insert(val);
+    fb.insert(val);
+    s.insert(val);
+  }
+  for (int i = 0; i < 2000; ++i) {
+    long val = random() % 10000;
+    b.erase(val);
+    fb.erase(val);
+    s.erase(val);
+  }
+  bool ok = sameAsSet(b, s) && sameAsSet(fb, s);
+  ok = ok && *b.upper_bound(5000) == *s.upper_bound(5000);
+  std::cout << "reversed: " << b.size() << " numbers, first " << *b.begin()
+            << ", last " << *b.rbegin() << std::endl;
+  std::cout << (ok ? "- agrees with std::set." : "- disagrees with std::set!") << std::endl;
+}
+
+void transparent(const std::vector<std::string>& words) {
+  btree<word, 0, false, word_less> b(5);
+  for (const auto& w : words)
+    b.insert(w.c_str());
+  std::cout << "transparent: inserting " << words.size() << " words built " << built
+            << " keys" << std::endl;
+  built = 0;
+  size_t found = 0;
+  for (const auto& w : words) {
+    found += b.find(w.c_str()) != b.end();
+    found += b.lower_bound(w.c_str()) != b.end();
+    found += b.equal_range(w.c_str()).first != b.end();
+  }
+  size_t added = 0;
+  for (const auto& w : words)
+    added += b.insert(w.c_str()).second;
+  std::cout << "- " << found << " lookups and " << words.size() << " inserts of words"
+            << " already there added " << added << " and built " << built << " keys" << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  auto words = readWords();
+  caseInsensitive(words);
+  reversed();
+  transparent(words);
+  return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * btree_map test.
+ * Runs the same random mix of operator[], insert, try_emplace,
+ * insert_or_assign and erase against btree_maps of each form and a std::map,
+ * checking after every round that they hold the same keys and values and
+ * that at() finds what is there and throws for what is not.
+ **/
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "btree_map.h"
+
+namespace {
+
+const long kMaxKey = 3000;
+const int kRounds = 5;
+const int kOpsPerRound = 4000;
+
+template <typename Map>
+bool sameAsMap(const Map& m, const std::map<long, std::string>& ref) {
+  if (m.size() != ref.size())
+    return false;
+  auto riter = ref.begin();
+  for (auto iter = m.begin(); iter != m.end(); ++iter, ++riter)
+    if (iter->first != riter->first || (*iter).second != riter->second)
+      return false;
+  for (long key = -1; key <= kMaxKey; ++key) {
+    bool mapped = true;
+    std::string val;
+    try {
+      val = m.at(key);
+    } catch (const std::out_of_range&) {
+      mapped = false;
+    }
+    auto found = ref.find(key);
+    if (mapped != (found != ref.end()) || (mapped && val != found->second))
+      return false;
+  }
+  return true;
+}
+
+template <typename Map>
+void test(const char *name, Map& m) {
+  srandom(6771);
+  std::map<long, std::string> ref;
+  bool ok = true;
+  size_t inserted = 0;
+  size_t assigned = 0;
+  for (int round = 0; round < kRounds; ++round) {
+    for (int i = 0; i < kOpsPerRound; ++i) {
+      long key = random() % kMaxKey;
+      auto val = std::to_string(random() % 1000);
+      switch (random() % 5) {
+      case 0:
+        m[key] += val;
+        ref[key] += val;
+        break;
+      case 1: {
+        auto res = m.insert(std::make_pair(key, val));
+        ok = res.second == ref.insert(std::make_pair(key, val)).second && ok;
+        break;
+      }
+      case 2:
+        inserted += m.try_emplace(key, 3, 'x').second;
+        ref.emplace(key, std::string(3, 'x'));
+        break;
+      case 3: {
+        auto res = m.insert_or_assign(key, val);
+        assigned += !res.second;
+        ok = res.first->second == val && ok;
+        ref[key] = val;
+        break;
+      }
+      default: {
+        auto erased = m.erase(key);
+        ok = erased == ref.erase(key) && ok;
+        break;
+      }
+      }
+    }
+    ok = sameAsMap(m, ref) && ok;
+  }
+  // Erase every other key through iterators
+  for (auto iter = m.begin(); iter != m.end();) {
+    ref.erase(iter->first);
+    iter = m.erase(iter);
+    if (iter != m.end())
+      ++iter;
+  }
+  ok = ok && sameAsMap(m, ref);
+  Map copy(m);
+  copy[kMaxKey] = "new";
+  ok = ok && sameAsMap(m, ref) && copy.size() == m.size() + 1;
+  std::cout << name << ": " << m.size() << " keys left, " << inserted << " placed by try_emplace, "
+            << assigned << " assigned by insert_or_assign" << std::endl;
+  std::cout << (ok ? "- agrees with std::map." : "- disagrees with std::map!") << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  btree_map<long, std::string> m(4);
+  test("btree_map", m);
+  btree_map<long, std::string, 8> fm;
+  test("btree_map<N = 8>", fm);
+  btree_map<long, std::string, 0, true> lm(5);
+  test("leaf-linked btree_map", lm);
+
+  // Mapped values that can only be moved
+  btree_map<std::string, std::unique_ptr<long>> pm(3);
+  for (long i = 0; i < 100; ++i)
+    pm[std::to_string(i)].reset(new long(i));
+  long sum = 0;
+  for (const auto& kv : pm)
+    sum += *kv.second;
+  std::cout << "move-only values sum to " << sum << std::endl;
+  return 0;
+}
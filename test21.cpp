@@ -0,0 +1,93 @@
+/**
+ * Snapshot benchmark.
+ * Fills a btree with 1M random values and compares taking a snapshot with
+ * copying the tree, in time and in memory. A reader thread then sums the
+ * snapshot over and over while the writer keeps inserting and erasing, and
+ * checks every pass sees the same elements.
+ **/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "btree.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+const size_t kSize = 1000000;
+const size_t kWrites = 200000;
+
+long getRandom(long low, long high) {
+  return (low + (random() % ((high - low) + 1)));
+}
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <typename View>
+long sum(const View& v) {
+  long res = 0;
+  for (auto val : v)
+    res += val;
+  return res;
+}
+
+}  // namespace close
+
+int main(void) {
+  srandom(6771);
+  btree<long> b;
+  while (b.size() < kSize)
+    b.insert(getRandom(kMinInteger, kMaxInteger));
+  auto before = b.slab_usage().used_bytes;
+
+  double copyMs = timeMs([&] { btree<long> copy(b); });
+  btree<long>::snapshot_view *view = nullptr;
+  double snapMs = timeMs([&] { view = new btree<long>::snapshot_view(b.snapshot()); });
+  std::cout << "copy of " << kSize << " elements: " << copyMs << " ms, snapshot: "
+            << snapMs << " ms" << std::endl;
+
+  long expected = sum(*view);
+  std::atomic<bool> done(false);
+  size_t passes = 0;
+  size_t mismatches = 0;
+  std::thread reader([&] {
+    while (!done.load()) {
+      mismatches += sum(*view) != expected;
+      ++passes;
+    }
+  });
+  double writeMs = timeMs([&] {
+    for (size_t i = 0; i < kWrites; ++i) {
+      auto val = getRandom(kMinInteger, kMaxInteger);
+      if (i % 2) {
+        b.insert(val);
+      } else {
+        auto it = b.lower_bound(val);
+        if (it != b.end())
+          b.erase(it);
+      }
+    }
+  });
+  done.store(true);
+  reader.join();
+  auto after = b.slab_usage().used_bytes;
+  std::cout << kWrites << " writes beside the snapshot: " << writeMs << " ms, "
+            << "nodes in use grew from " << before / 1024 << " to " << after / 1024
+            << " KiB" << std::endl;
+  std::cout << "reader made " << passes << " passes over the snapshot, "
+            << mismatches << " saw a change" << std::endl;
+  delete view;
+  std::cout << "after the snapshot is gone " << b.slab_usage().used_bytes / 1024
+            << " KiB are in use" << std::endl;
+  return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * Multi-threaded benchmark.
+ * First has threads insert and erase disjoint sets of numbers in a
+ * concurrent_btree at once, checking it against a std::set of what they
+ * did, and has readers find elements others are writing, checking every
+ * copy find hands back is whole. Then fills a concurrent_btree and a
+ * btree behind one mutex with 1M random numbers and times a mix of 95%
+ * finds and 5% writes on each, for growing numbers of threads, reporting
+ * how each scales against one thread. Only thread counts up to the number
+ * of cores can show the concurrent_btree scaling.
+ **/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "btree.h"
+#include "concurrent_btree.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+const size_t kSize = 1000000;
+const size_t kOpsPerThread = 400000;
+const size_t kCheckPerThread = 50000;
+const unsigned kMaxThreads = 8;
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <typename F>
+void runThreads(unsigned threads, F f) {
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; ++t)
+    pool.emplace_back(f, t);
+  for (auto& th : pool)
+    th.join();
+}
+
+// The btree as it is shared today, every call under the one lock
+class locked_btree {
+public:
+  bool contains(long key) const {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _tree.find(key) != _tree.end();
+  }
+  bool insert(long key) {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _tree.insert(key).second;
+  }
+  bool erase(long key) {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _tree.erase(key);
+  }
+
+private:
+  mutable std::mutex _lock;
+  btree<long> _tree;
+};
+
+// Thread t only writes numbers congruent to t, so the end result is known
+void check(unsigned threads) {
+  concurrent_btree<long, 8> b;
+  std::vector<std::set<long>> kept(threads);
+  runThreads(threads, [&](unsigned t) {
+    std::minstd_rand gen(6771 + t);
+    for (size_t i = 0; i < kCheckPerThread; ++i) {
+      long val = long(gen() % 20000) * threads + t;
+      if (gen() % 3) {
+        b.insert(val);
+        kept[t].insert(val);
+      } else {
+        b.erase(val);
+        kept[t].erase(val);
+      }
+      b.contains(val + 1);
+    }
+  });
+  std::set<long> s;
+  for (const auto& k : kept)
+    s.insert(k.begin(), k.end());
+  bool ok = b.size() == s.size();
+  for (long val = 0; val < 20000 * long(threads); ++val)
+    ok = ok && b.contains(val) == (s.count(val) == 1);
+  std::cout << threads << " writers left " << b.size() << " numbers: "
+            << (ok ? "agrees with std::set." : "disagrees with std::set!") << std::endl;
+}
+
+// A number and its square, ordered by the number alone
+struct squared {
+  long key;
+  long square;
+};
+struct squared_less {
+  bool operator()(const squared& a, const squared& b) const { return a.key < b.key; }
+};
+
+// Readers find what writers insert and erase, a torn copy would not square
+void checkFind(unsigned threads) {
+  concurrent_btree<squared, 8, squared_less> b;
+  std::atomic<bool> done(false);
+  std::atomic<bool> whole(true);
+  std::thread writer([&] {
+    std::minstd_rand gen(6771);
+    for (size_t i = 0; i < kCheckPerThread * threads; ++i) {
+      long key = gen() % 20000;
+      if (gen() % 3)
+        b.insert(squared{key, key * key});
+      else
+        b.erase(squared{key, 0});
+    }
+    done.store(true);
+  });
+  runThreads(threads, [&](unsigned t) {
+    std::minstd_rand gen(6771 + t);
+    while (!done.load()) {
+      long key = gen() % 20000;
+      squared out{-1, -1};
+      if (b.find(squared{key, 0}, out) && (out.key != key || out.square != key * key))
+        whole.store(false);
+    }
+  });
+  writer.join();
+  std::cout << threads << " readers finding beside a writer: "
+            << (whole.load() ? "every copy whole." : "torn copies found!") << std::endl;
+}
+
+template <typename Tree>
+double mixedOps(Tree& b, unsigned threads) {
+  size_t found = 0;
+  std::mutex foundLock;
+  double ms = timeMs([&] {
+    runThreads(threads, [&](unsigned t) {
+      std::minstd_rand gen(6771 + t);
+      std::uniform_int_distribution<long> dist(kMinInteger, kMaxInteger);
+      size_t hits = 0;
+      for (size_t i = 0; i < kOpsPerThread; ++i) {
+        long val = dist(gen);
+        switch (i % 40) {
+        case 0:
+          b.insert(val);
+          break;
+        case 20:
+          b.erase(val);
+          break;
+        default:
+          hits += b.contains(val);
+        }
+      }
+      std::lock_guard<std::mutex> guard(foundLock);
+      found += hits;
+    });
+  });
+  return threads * kOpsPerThread / ms / 1000;
+}
+
+}  // namespace close
+
+int main(void) {
+  auto cores = std::thread::hardware_concurrency();
+  std::cout << cores << " hardware threads" << std::endl;
+  check(1);
+  check(4);
+  checkFind(4);
+
+  srandom(6771);
+  concurrent_btree<long> cb;
+  locked_btree lb;
+  while (cb.size() < kSize) {
+    long val = kMinInteger + random() % (kMaxInteger - kMinInteger + 1);
+    cb.insert(val);
+    lb.insert(val);
+  }
+  double locked1 = 0, concurrent1 = 0;
+  for (unsigned threads = 1; threads <= kMaxThreads; threads *= 2) {
+    auto locked = mixedOps(lb, threads);
+    auto concurrent = mixedOps(cb, threads);
+    if (threads == 1) {
+      locked1 = locked;
+      concurrent1 = concurrent;
+    }
+    std::cout << threads << " threads, 95% finds: btree behind a mutex " << locked << " Mops/s ("
+              << locked / locked1 << "x of 1 thread), concurrent_btree " << concurrent << " Mops/s ("
+              << concurrent / concurrent1 << "x)"
+              << (threads > cores ? ", more threads than cores" : "") << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Epoch reclamation test.
+ * Writers fill and empty a small concurrent_btree over and over, so its
+ * nodes are taken out of the tree again and again, while readers search
+ * it. Reports how many nodes are still waiting to be freed, which should
+ * stay small however long this runs, checks that none are left once every
+ * thread is done and btree_epoch::flush() has run, and checks the tree
+ * against a std::set. Then times finds that each enter an epoch against
+ * finds under one btree_epoch::guard.
+ **/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "concurrent_btree.h"
+
+namespace {
+
+const unsigned kWriters = 3;
+const unsigned kReaders = 2;
+const long kRange = 2000;
+const int kRounds = 30;
+const size_t kFinds = 2000000;
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+void churn() {
+  concurrent_btree<long, 4> b;
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (unsigned t = 0; t < kReaders; ++t)
+    readers.emplace_back([&, t] {
+      std::minstd_rand gen(6771 + t);
+      while (!done.load())
+        b.contains(gen() % (kRange * kWriters));
+    });
+  // Writer t owns the numbers congruent to t, and leaves every third
+  std::vector<std::thread> writers;
+  size_t maxPending = 0;
+  for (int round = 0; round < kRounds; ++round) {
+    for (unsigned t = 0; t < kWriters; ++t)
+      writers.emplace_back([&, t] {
+        for (long val = 0; val < kRange; ++val)
+          b.insert(val * kWriters + t);
+        for (long val = 0; val < kRange; ++val)
+          if (val % 3)
+            b.erase(val * kWriters + t);
+      });
+    for (auto& th : writers)
+      th.join();
+    writers.clear();
+    maxPending = std::max(maxPending, btree_epoch::pending());
+  }
+  done.store(true);
+  for (auto& th : readers)
+    th.join();
+  // No thread is in an epoch any more, so everything retired can go
+  btree_epoch::flush();
+  size_t leftPending = btree_epoch::pending();
+  std::set<long> s;
+  for (unsigned t = 0; t < kWriters; ++t)
+    for (long val = 0; val < kRange; val += 3)
+      s.insert(val * kWriters + t);
+  bool ok = b.size() == s.size() && leftPending == 0;
+  for (long val = 0; val < kRange * kWriters; ++val)
+    ok = ok && b.contains(val) == (s.count(val) == 1);
+  std::cout << kRounds << " rounds of " << kWriters << " writers: at most " << maxPending
+            << " nodes waiting to be freed after a round, " << leftPending << " once all are done"
+            << std::endl;
+  std::cout << (ok ? "- agrees with std::set." : "- disagrees with std::set!") << std::endl;
+}
+
+void guardCost() {
+  concurrent_btree<long> b;
+  for (long val = 0; val < 1000000; val += 2)
+    b.insert(val);
+  std::minstd_rand gen(6771);
+  size_t found = 0;
+  double each = timeMs([&] {
+    for (size_t i = 0; i < kFinds; ++i)
+      found += b.contains(gen() % 1000000);
+  });
+  double once = timeMs([&] {
+    btree_epoch::guard guard;
+    for (size_t i = 0; i < kFinds; ++i)
+      found += b.contains(gen() % 1000000);
+  });
+  std::cout << kFinds << " finds entering an epoch each: " << each << " ms, under one guard: "
+            << once << " ms (" << found << " found)" << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  churn();
+  guardCost();
+  return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * Sharded btree test and benchmark.
+ * Starts a sharded_btree with splitters that send every number to its last
+ * shard, has threads insert and erase numbers in it, and shows that shard
+ * draining into its neighbours as it goes and rebalance() then evening all
+ * of them out, then checks it against a std::set both by iterating and
+ * through for_each. Then times inserts and erases from
+ * growing numbers of threads into a btree behind one mutex and into a
+ * sharded_btree of 16 shards.
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "btree.h"
+#include "sharded_btree.h"
+
+namespace {
+
+const long kMaxInteger = 100000000;
+const unsigned kShards = 16;
+const size_t kCheckPerThread = 100000;
+const size_t kOpsPerThread = 200000;
+const unsigned kMaxThreads = 8;
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <typename F>
+void runThreads(unsigned threads, F f) {
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; ++t)
+    pool.emplace_back(f, t);
+  for (auto& th : pool)
+    th.join();
+}
+
+class locked_btree {
+public:
+  bool insert(long key) {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _tree.insert(key).second;
+  }
+  size_t erase(long key) {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _tree.erase(key);
+  }
+
+private:
+  std::mutex _lock;
+  btree<long> _tree;
+};
+
+std::vector<long> evenSplitters(unsigned shards, long max) {
+  std::vector<long> res;
+  for (unsigned i = 1; i < shards; ++i)
+    res.push_back(max / shards * i);
+  return res;
+}
+
+template <typename Tree>
+void printShards(const char *when, const Tree& b) {
+  size_t least = b.size(), most = 0;
+  for (size_t i = 0; i < b.shards(); ++i) {
+    least = std::min(least, b.shard_size(i));
+    most = std::max(most, b.shard_size(i));
+  }
+  std::cout << when << ": " << b.size() << " numbers, shards hold " << least << " to "
+            << most << std::endl;
+}
+
+void check(unsigned threads) {
+  // Every number is past the last splitter
+  sharded_btree<long> b(evenSplitters(8, -1000), 16);
+  std::vector<std::set<long>> kept(threads);
+  runThreads(threads, [&](unsigned t) {
+    std::minstd_rand gen(6771 + t);
+    for (size_t i = 0; i < kCheckPerThread; ++i) {
+      long val = long(gen() % 100000) * threads + t;
+      if (gen() % 4) {
+        b.insert(val);
+        kept[t].insert(val);
+      } else {
+        b.erase(val);
+        kept[t].erase(val);
+      }
+    }
+  });
+  printShards("after inserts", b);
+  std::set<long> s;
+  for (const auto& k : kept)
+    s.insert(k.begin(), k.end());
+  bool ok = b.size() == s.size() && std::equal(b.begin(), b.end(), s.begin());
+  b.rebalance();
+  printShards("after rebalance()", b);
+  std::vector<long> seen;
+  b.for_each([&](long val) { seen.push_back(val); });
+  ok = ok && seen.size() == s.size() && std::equal(seen.begin(), seen.end(), s.begin());
+  for (long val = 0; val < 1000; ++val)
+    ok = ok && b.contains(val) == (s.count(val) == 1);
+  std::cout << (ok ? "- agrees with std::set." : "- disagrees with std::set!") << std::endl;
+}
+
+template <typename Tree>
+double writes(Tree& b, unsigned threads) {
+  double ms = timeMs([&] {
+    runThreads(threads, [&](unsigned t) {
+      std::minstd_rand gen(6771 + t);
+      std::uniform_int_distribution<long> dist(0, kMaxInteger - 1);
+      for (size_t i = 0; i < kOpsPerThread; ++i) {
+        if (i % 4 == 3)
+          b.erase(dist(gen));
+        else
+          b.insert(dist(gen));
+      }
+    });
+  });
+  return threads * kOpsPerThread / ms / 1000;
+}
+
+}  // namespace close
+
+int main(void) {
+  std::cout << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+  check(1);
+  check(4);
+  for (unsigned threads = 1; threads <= kMaxThreads; threads *= 2) {
+    locked_btree lb;
+    sharded_btree<long> sb(evenSplitters(kShards, kMaxInteger));
+    auto locked = writes(lb, threads);
+    auto sharded = writes(sb, threads);
+    std::cout << threads << " threads writing: btree behind a mutex " << locked
+              << " Mops/s, " << kShards << " shards " << sharded << " Mops/s" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * Parallel bulk build benchmark.
+ * Builds a btree from 5M sorted numbers with assign and with
+ * parallel_assign on growing numbers of threads, then from the same
+ * numbers shuffled with std::sort and assign against parallel_sort_assign,
+ * for full nodes and for nodes left 70% full. Checks every tree comes out
+ * the same as the one built by assign: the same elements in the same
+ * order, in nodes taking up the same memory.
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+const size_t kSize = 5000000;
+const unsigned kMaxThreads = 16;
+const double kFills[] = {1.0, 0.7};
+
+template <typename F>
+double timeMs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+// Same elements in the same order, in nodes taking up the same memory
+bool same(const btree<long>& a, const btree<long>& b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin()) &&
+         a.slab_usage().used_bytes == b.slab_usage().used_bytes;
+}
+
+}  // namespace close
+
+int main(void) {
+  std::cout << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+  std::minstd_rand gen(6771);
+  std::vector<long> sorted(kSize);
+  for (auto& val : sorted)
+    val = gen() % (kSize * 4);
+  std::sort(sorted.begin(), sorted.end());
+  auto shuffled = sorted;
+  std::shuffle(shuffled.begin(), shuffled.end(), gen);
+
+  bool ok = true;
+  for (double fill : kFills) {
+    btree<long> expected;
+    double ms = timeMs([&] { expected.assign(sorted.begin(), sorted.end(), fill); });
+    std::cout << "assign of " << kSize << " sorted numbers, nodes " << fill * 100 << "% full: "
+              << ms << " ms, " << expected.size() << " distinct in "
+              << expected.slab_usage().used_bytes / 1024 << " KiB" << std::endl;
+    for (unsigned threads = 1; threads <= kMaxThreads; threads *= 2) {
+      btree<long> b;
+      ms = timeMs([&] { b.parallel_assign(sorted.begin(), sorted.end(), threads, fill); });
+      ok = same(b, expected) && ok;
+      std::cout << "parallel_assign on " << threads << " threads: " << ms << " ms" << std::endl;
+    }
+
+    auto input = shuffled;
+    btree<long> b;
+    ms = timeMs([&] {
+      std::sort(input.begin(), input.end());
+      b.assign(input.begin(), input.end(), fill);
+    });
+    ok = same(b, expected) && ok;
+    std::cout << "std::sort and assign of the numbers shuffled: " << ms << " ms" << std::endl;
+    for (unsigned threads = 1; threads <= kMaxThreads; threads *= 2) {
+      input = shuffled;
+      btree<long> b;
+      ms = timeMs([&] { b.parallel_sort_assign(input.begin(), input.end(), threads, fill); });
+      ok = same(b, expected) && ok;
+      std::cout << "parallel_sort_assign on " << threads << " threads: " << ms << " ms" << std::endl;
+    }
+  }
+  std::cout << (ok ? "- every tree matches." : "- trees differ!") << std::endl;
+  return 0;
+}